@@ -55,7 +55,7 @@ template <Memory_Order order = Memory_Order::Relaxed, typename T>
 static T atomic_fetch_add (Atomic<T> &atomic, s32 value) {
   T last = value;
   asm volatile (
-    "lock xadd %1, %0"
+    "lock xadd %0, %1"
     : "+r"(last), "+m"(atomic.value)
     : 
     : "memory"
@@ -74,7 +74,7 @@ template <Memory_Order success = Memory_Order::Acquire_Release,
 static bool atomic_compare_and_set (Atomic<T> &atomic, Atomic_Value<T> expected, Atomic_Value<T> new_value) {
   Atomic_Value<T> result;
   asm volatile (
-    "lock cmpxchg %1, %3\n"
+    "lock cmpxchg %3, %1\n"
     : "=a"(result), "+m"(atomic.value)
     : "a"(expected), "r"(new_value)
     : "cc", "memory"
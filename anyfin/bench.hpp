@@ -0,0 +1,405 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/arena.hpp"
+#include "anyfin/array.hpp"
+#include "anyfin/buffered_writer.hpp"
+#include "anyfin/callsite.hpp"
+#include "anyfin/perf_counters.hpp"
+#include "anyfin/slice.hpp"
+#include "anyfin/sort.hpp"
+#include "anyfin/strings.hpp"
+#include "anyfin/timers.hpp"
+
+/*
+  Micro-benchmarks are defined at the namespace scope and registered automatically. The body receives the
+  number of iterations to run, the harness picks it so that each sample lasts long enough to be measured
+  precisely:
+
+    define_benchmark("copy_string") {
+      for (u64 idx = 0; idx < state.iterations; idx++) {
+        auto copy = copy_string(arena, text);
+        do_not_optimize(copy);
+      }
+    }
+
+  Registration is local to the translation unit, benchmarks must be defined in the same unit that calls
+  run_benchmarks.
+ */
+#define define_benchmark(NAME) fin_define_benchmark(NAME, __COUNTER__)
+
+#define fin_define_benchmark(NAME, ID)                                                   \
+  static void tokenpaste(__benchmark_proc, ID) (Fin::Bench_State &state);               \
+  static Fin::Benchmark tokenpaste(__benchmark, ID) { NAME, tokenpaste(__benchmark_proc, ID), Fin::Callsite() }; \
+  static void tokenpaste(__benchmark_proc, ID) ([[maybe_unused]] Fin::Bench_State &state)
+
+namespace Fin {
+
+struct Bench_State {
+  u64 iterations;
+};
+
+/*
+  Keeps the compiler from optimizing away the computation of the value, without the cost of storing it.
+ */
+template <typename T>
+fin_forceinline
+static void do_not_optimize (const T &value) {
+  asm volatile ("" : : "r,m"(value) : "memory");
+}
+
+/*
+  Forces the pending writes to memory to be considered observable, so they aren't eliminated as dead stores.
+ */
+fin_forceinline
+static void clobber_memory () {
+  asm volatile ("" : : : "memory");
+}
+
+fin_forceinline
+static u64 read_cycle_counter () {
+#ifdef CPU_ARCH_X64
+  return __builtin_ia32_rdtsc();
+#else
+  return get_timer_value();
+#endif
+}
+
+struct Benchmark {
+  const char *name;
+  void      (*proc) (Bench_State &);
+  Callsite    callsite;
+
+  Benchmark  *next = nullptr;
+
+  Benchmark (const char *_name, void (*_proc) (Bench_State &), Callsite _callsite);
+};
+
+/*
+  Registered benchmarks in the order of their definition.
+ */
+static struct {
+  Benchmark *first = nullptr;
+  Benchmark *last  = nullptr;
+  usize      count = 0;
+} registered_benchmarks;
+
+inline Benchmark::Benchmark (const char *_name, void (*_proc) (Bench_State &), Callsite _callsite)
+  : name { _name }, proc { _proc }, callsite { _callsite }
+{
+  if (registered_benchmarks.last) registered_benchmarks.last->next = this;
+  else                            registered_benchmarks.first      = this;
+
+  registered_benchmarks.last   = this;
+  registered_benchmarks.count += 1;
+}
+
+struct Bench_Options {
+  u32 samples_count    = 30;
+  u64 min_sample_nanos = 5'000'000;
+  u64 warmup_nanos     = 100'000'000;
+
+  /*
+    Measure hardware counters alongside the time, if the platform allows it. Counters are read outside of the
+    timed region and don't affect the time measurements.
+   */
+  bool collect_counters = true;
+
+  /*
+    Only benchmarks whose name contains this string are run, all if empty.
+   */
+  String filter;
+};
+
+/*
+  Statistics over the samples' time per iteration. Median and MAD (median absolute deviation) are robust to the
+  occasional outliers caused by interrupts and preemption, the confidence interval is the 95% interval of the
+  mean under the normal approximation. Cycles are TSC reference cycles, which on modern CPUs tick at the nominal
+  frequency regardless of the current clock speed.
+
+  Hardware counters are averaged over all iterations of all samples, `counters_mask` tells which of them were
+  measured, it's zero when counters are unavailable.
+ */
+struct Bench_Result {
+  const Benchmark *benchmark;
+
+  u64 iterations; // Per sample
+  u32 samples_count;
+
+  double median_nanos;
+  double mad_nanos;
+  double mean_nanos;
+  double min_nanos;
+  double confidence_low_nanos;
+  double confidence_high_nanos;
+  double cycles_per_iteration;
+
+  double counters_per_iteration[perf_counters_count];
+  u32    counters_mask;
+};
+
+static double get_sorted_median (const double *values, usize count) {
+  return (count % 2) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
+
+static Bench_Result run_benchmark (Memory_Arena arena, const Benchmark &benchmark, const Bench_Options &options,
+                                   const Perf_Counter_Group *counters = nullptr) {
+  fin_ensure(options.samples_count > 0);
+
+  auto frequency = get_timer_frequency();
+
+  const auto measure = [&] (u64 iterations, u64 &cycles) -> u64 {
+    Bench_State state { iterations };
+
+    clobber_memory();
+    auto start_cycles = read_cycle_counter();
+    auto start        = get_timer_value();
+
+    benchmark.proc(state);
+
+    auto end        = get_timer_value_serialized();
+    auto end_cycles = read_cycle_counter();
+    clobber_memory();
+
+    cycles = end_cycles - start_cycles;
+
+    return get_elapsed_nanos(frequency, start, end);
+  };
+
+  /*
+    Grow the iterations count until a single sample takes at least min_sample_nanos, extrapolating from the last
+    measurement, but not more than tenfold at a time, since the first runs are the least reliable.
+   */
+  u64 iterations = 1, cycles = 0;
+  while (true) {
+    auto elapsed = measure(iterations, cycles);
+    if (elapsed >= options.min_sample_nanos) break;
+
+    auto estimate = elapsed ? (iterations * options.min_sample_nanos * 12 / 10) / elapsed : iterations * 10;
+    auto limit    = iterations * 10;
+
+    iterations = estimate > limit ? limit : (estimate > iterations ? estimate : iterations + 1);
+  }
+
+  for (u64 warmed_up = 0; warmed_up < options.warmup_nanos;) warmed_up += measure(iterations, cycles);
+
+  auto samples = reserve_array<double>(arena, options.samples_count);
+  auto cycle_samples = reserve_array<double>(arena, options.samples_count);
+  fin_ensure(samples.values && cycle_samples.values);
+
+  Perf_Counter_Values counter_totals { .available_mask = counters ? counters->available_mask : 0u };
+
+  for (u32 idx = 0; idx < options.samples_count; idx++) {
+    Perf_Counter_Values counters_start;
+    if (counter_totals.available_mask) counters_start = read_perf_counters(*counters);
+
+    auto elapsed = measure(iterations, cycles);
+
+    if (counter_totals.available_mask) {
+      auto deltas = get_counter_deltas(counters_start, read_perf_counters(*counters));
+
+      // A failed read drops the counter for the whole run rather than skewing its average.
+      counter_totals.available_mask &= deltas.available_mask;
+      for (usize counter = 0; counter < perf_counters_count; counter++) counter_totals.values[counter] += deltas.values[counter];
+    }
+
+    samples[idx]       = static_cast<double>(elapsed) / static_cast<double>(iterations);
+    cycle_samples[idx] = static_cast<double>(cycles)  / static_cast<double>(iterations);
+  }
+
+  const auto less = [] (const double &left, const double &right) { return left < right; };
+
+  sort(slice(samples), less);
+  sort(slice(cycle_samples), less);
+
+  auto count  = samples.count;
+  auto median = get_sorted_median(samples.values, count);
+
+  double sum = 0;
+  for (auto value: samples) sum += value;
+  auto mean = sum / count;
+
+  double squares = 0;
+  for (auto value: samples) squares += (value - mean) * (value - mean);
+  auto deviation = count > 1 ? __builtin_sqrt(squares / (count - 1)) : 0.0;
+  auto margin    = 1.96 * deviation / __builtin_sqrt(static_cast<double>(count));
+
+  // Deviations are computed in place of the cycle samples' copy, which is no longer needed after its median.
+  auto cycles_median = get_sorted_median(cycle_samples.values, count);
+  for (usize idx = 0; idx < count; idx++) {
+    auto distance = samples[idx] - median;
+    cycle_samples[idx] = distance < 0 ? -distance : distance;
+  }
+  sort(slice(cycle_samples), less);
+
+  Bench_Result result {
+    .benchmark             = &benchmark,
+    .iterations            = iterations,
+    .samples_count         = options.samples_count,
+    .median_nanos          = median,
+    .mad_nanos             = get_sorted_median(cycle_samples.values, count),
+    .mean_nanos            = mean,
+    .min_nanos             = samples[0],
+    .confidence_low_nanos  = mean - margin,
+    .confidence_high_nanos = mean + margin,
+    .cycles_per_iteration  = cycles_median,
+    .counters_mask         = counter_totals.available_mask,
+  };
+
+  auto total_iterations = static_cast<double>(iterations) * options.samples_count;
+  for (usize idx = 0; idx < perf_counters_count; idx++) {
+    result.counters_per_iteration[idx] = static_cast<double>(counter_totals.values[idx]) / total_iterations;
+  }
+
+  return result;
+}
+
+/*
+  Run all registered benchmarks matching the filter, one after another. Results are placed into the arena.
+ */
+static Array<Bench_Result> run_benchmarks (Memory_Arena &arena, const Bench_Options &options = {}) {
+  auto results = reserve_array<Bench_Result>(arena, registered_benchmarks.count);
+  fin_ensure(results.values || registered_benchmarks.count == 0);
+
+  // Benchmarks run without the counters if they can't be opened, e.g. when perf events are restricted.
+  Perf_Counter_Group counters;
+  if (options.collect_counters) {
+    auto [error, group] = open_perf_counters();
+    if (!error) counters = group;
+  }
+
+  usize count = 0;
+  for (auto benchmark = registered_benchmarks.first; benchmark; benchmark = benchmark->next) {
+    if (!is_empty(options.filter) && !has_substring(String(cast_bytes(benchmark->name)), options.filter)) continue;
+
+    results[count++] = run_benchmark(arena, *benchmark, options, &counters);
+  }
+
+  close_perf_counters(counters);
+
+  return Array(results.values, count);
+}
+
+/*
+  Fixed-point rendering with 3 decimal places, which is more than the precision of any measurement here.
+ */
+static String render_decimal (char (&buffer)[32], double value) {
+  bool is_negative = value < 0;
+  if (is_negative) value = -value;
+
+  auto scaled  = static_cast<u64>(value * 1000.0 + 0.5);
+  auto cursor  = buffer + sizeof(buffer);
+
+  for (int idx = 0; idx < 3; idx++) {
+    *--cursor = static_cast<char>('0' + scaled % 10);
+    scaled /= 10;
+  }
+  *--cursor = '.';
+
+  do {
+    *--cursor = static_cast<char>('0' + scaled % 10);
+    scaled /= 10;
+  } while (scaled);
+
+  if (is_negative) *--cursor = '-';
+
+  return String(cursor, buffer + sizeof(buffer) - cursor);
+}
+
+static Sys_Result<void> write_bench_text (Buffered_Writer &writer, Slice<Bench_Result> results) {
+  for (auto &result: results) {
+    char median[32], mad[32], low[32], high[32], cycles[32], iterations[24], samples[24];
+
+    String line[] {
+      String(cast_bytes(result.benchmark->name)),
+      ": ", render_decimal(median, result.median_nanos), " ns/iter",
+      " (mad ", render_decimal(mad, result.mad_nanos),
+      ", 95% ci ", render_decimal(low, result.confidence_low_nanos), "..", render_decimal(high, result.confidence_high_nanos),
+      ", ", render_decimal(cycles, result.cycles_per_iteration), " cycles/iter",
+      ", ", render_unsigned(samples, result.samples_count), "x", render_unsigned(iterations, result.iterations), " iterations)\n",
+    };
+
+    fin_check(buffered_write(writer, Slice(line)));
+
+    if (!result.counters_mask) continue;
+
+    using enum Perf_Counter;
+
+    const auto get_counter = [&result] (Perf_Counter counter) {
+      return result.counters_per_iteration[static_cast<u32>(counter)];
+    };
+
+    fin_check(buffered_write(writer, "  "));
+
+    if (has_counter(result.counters_mask, Cycles) && has_counter(result.counters_mask, Instructions) && get_counter(Cycles) > 0) {
+      char ipc[32];
+      String values[] { "ipc ", render_decimal(ipc, get_counter(Instructions) / get_counter(Cycles)), ", " };
+      fin_check(buffered_write(writer, Slice(values)));
+    }
+
+    bool is_first = true;
+    for (u32 idx = 0; idx < perf_counters_count; idx++) {
+      if (!has_counter(result.counters_mask, static_cast<Perf_Counter>(idx))) continue;
+
+      char value[32];
+      String values[] {
+        is_first ? "" : ", ",
+        String(cast_bytes(perf_counter_names[idx])), " ",
+        render_decimal(value, result.counters_per_iteration[idx]),
+      };
+      fin_check(buffered_write(writer, Slice(values)));
+
+      is_first = false;
+    }
+
+    fin_check(buffered_write(writer, " per iter\n"));
+  }
+
+  return Ok();
+}
+
+/*
+  Machine-readable results for comparing runs. Benchmark names are written as is and shouldn't contain
+  characters that need escaping.
+ */
+static Sys_Result<void> write_bench_json (Buffered_Writer &writer, Slice<Bench_Result> results) {
+  fin_check(buffered_write(writer, "{\"benchmarks\":["));
+
+  for (usize idx = 0; idx < results.count; idx++) {
+    auto &result = results[idx];
+
+    char median[32], mad[32], mean[32], minimum[32], low[32], high[32], cycles[32], iterations[24], samples[24];
+
+    String entry[] {
+      idx ? ",\n{\"name\":\"" : "\n{\"name\":\"", String(cast_bytes(result.benchmark->name)),
+      "\",\"median_ns\":",   render_decimal(median, result.median_nanos),
+      ",\"mad_ns\":",        render_decimal(mad, result.mad_nanos),
+      ",\"mean_ns\":",       render_decimal(mean, result.mean_nanos),
+      ",\"min_ns\":",        render_decimal(minimum, result.min_nanos),
+      ",\"ci_low_ns\":",     render_decimal(low, result.confidence_low_nanos),
+      ",\"ci_high_ns\":",    render_decimal(high, result.confidence_high_nanos),
+      ",\"cycles_per_iteration\":", render_decimal(cycles, result.cycles_per_iteration),
+      ",\"iterations\":",    render_unsigned(iterations, result.iterations),
+      ",\"samples\":",       render_unsigned(samples, result.samples_count),
+    };
+
+    fin_check(buffered_write(writer, Slice(entry)));
+
+    for (u32 counter = 0; counter < perf_counters_count; counter++) {
+      if (!has_counter(result.counters_mask, static_cast<Perf_Counter>(counter))) continue;
+
+      char value[32];
+      String values[] {
+        ",\"", String(cast_bytes(perf_counter_names[counter])), "_per_iteration\":",
+        render_decimal(value, result.counters_per_iteration[counter]),
+      };
+      fin_check(buffered_write(writer, Slice(values)));
+    }
+
+    fin_check(buffered_write(writer, "}"));
+  }
+
+  return buffered_write(writer, "\n]}\n");
+}
+
+}
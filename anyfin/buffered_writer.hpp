@@ -0,0 +1,150 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/arena.hpp"
+#include "anyfin/file_system.hpp"
+#include "anyfin/prelude.hpp"
+#include "anyfin/slice.hpp"
+#include "anyfin/string_builder.hpp"
+#include "anyfin/strings.hpp"
+
+namespace Fin {
+
+/*
+  Accumulates small writes into a fixed buffer and hands them to the file in large chunks.
+  Writes that don't fit into the buffer, as well as lists of strings, are submitted together with the pending
+  buffer content using a single gathered write, without copying them into the buffer first.
+  Data that's still buffered must be flushed explicitly before the file is closed.
+ */
+struct Buffered_Writer {
+  File *file;
+
+  char  *buffer;
+  usize  capacity;
+  usize  offset = 0;
+
+  Buffered_Writer (File &_file, Memory_Arena &arena, usize buffer_size = kilobytes(64))
+    : file     { &_file },
+      buffer   { reserve<char>(arena, buffer_size) },
+      capacity { buffer_size }
+  {
+    fin_ensure(buffer);
+    fin_ensure(capacity > 0);
+  }
+
+  Buffered_Writer (File &_file, char *_buffer, usize buffer_size)
+    : file { &_file }, buffer { _buffer }, capacity { buffer_size }
+  {
+    fin_ensure(buffer);
+    fin_ensure(capacity > 0);
+  }
+};
+
+fin_forceinline
+static usize get_remaining_space (const Buffered_Writer &writer) {
+  return writer.capacity - writer.offset;
+}
+
+static Sys_Result<void> flush (Buffered_Writer &writer) {
+  if (writer.offset == 0) return Ok();
+
+  fin_check(write_bytes_to_file(*writer.file, writer.buffer, writer.offset));
+  writer.offset = 0;
+
+  return Ok();
+}
+
+/*
+  Submits whatever is pending in the buffer followed by the sections with a single vectored write.
+ */
+static Sys_Result<void> flush_with_sections (Buffered_Writer &writer, Slice<String> sections) {
+  constexpr usize batch_limit = 64;
+  String batch[batch_limit];
+
+  usize count = 0;
+  if (writer.offset) batch[count++] = String(writer.buffer, writer.offset);
+
+  for (auto &section: sections) {
+    if (is_empty(section)) continue;
+
+    if (count == batch_limit) {
+      fin_check(write_gathered_to_file(*writer.file, Slice(batch, count)));
+      count = 0;
+    }
+
+    batch[count++] = section;
+  }
+
+  if (count) fin_check(write_gathered_to_file(*writer.file, Slice(batch, count)));
+  writer.offset = 0;
+
+  return Ok();
+}
+
+static Sys_Result<void> buffered_write (Buffered_Writer &writer, String data) {
+  if (is_empty(data)) return Ok();
+
+  if (data.length <= get_remaining_space(writer)) {
+    copy_memory(writer.buffer + writer.offset, data.value, data.length);
+    writer.offset += data.length;
+
+    return Ok();
+  }
+
+  /*
+    Large writes bypass the buffer entirely, going to the file together with what's been buffered so far.
+   */
+  if (data.length >= writer.capacity) return flush_with_sections(writer, Slice(&data, 1));
+
+  fin_check(flush(writer));
+
+  copy_memory(writer.buffer, data.value, data.length);
+  writer.offset = data.length;
+
+  return Ok();
+}
+
+static Sys_Result<void> buffered_write (Buffered_Writer &writer, Slice<String> sections) {
+  usize total_length = 0;
+  for (auto &section: sections) total_length += section.length;
+
+  if (total_length > get_remaining_space(writer)) return flush_with_sections(writer, sections);
+
+  for (auto &section: sections) {
+    copy_memory(writer.buffer + writer.offset, section.value, section.length);
+    writer.offset += section.length;
+  }
+
+  return Ok();
+}
+
+static Sys_Result<void> buffered_write (Buffered_Writer &writer, const String_Builder &builder) {
+  if (builder.length <= get_remaining_space(writer)) {
+    for (auto &section: builder.sections) {
+      copy_memory(writer.buffer + writer.offset, section.value, section.length);
+      writer.offset += section.length;
+    }
+
+    return Ok();
+  }
+
+  /*
+    Builder's sections live in a linked list, gathering them in fixed batches for the vectored write.
+   */
+  constexpr usize batch_limit = 64;
+  String batch[batch_limit];
+
+  usize count = 0;
+  for (auto &section: builder.sections) {
+    batch[count++] = section;
+
+    if (count == batch_limit) {
+      fin_check(flush_with_sections(writer, Slice(batch, count)));
+      count = 0;
+    }
+  }
+
+  return flush_with_sections(writer, Slice(batch, count));
+}
+
+}
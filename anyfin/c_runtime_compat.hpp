@@ -26,6 +26,18 @@ void* memcpy(void* dest, const void* src, size_t n) {
   return dest;
 }
 
+#pragma function(memmove)
+void* memmove(void* dest, const void* src, size_t n) {
+  char* d = (char*)dest;
+  const char* s = (const char*)src;
+  if (d < s) {
+    for (size_t i = 0; i < n; i++) d[i] = s[i];
+  } else {
+    for (size_t i = n; i > 0; i--) d[i - 1] = s[i - 1];
+  }
+  return dest;
+}
+
 #pragma function(memcmp)
 int memcmp(const void* s1, const void* s2, size_t n) {
   const unsigned char* p1 = (const unsigned char*)s1;
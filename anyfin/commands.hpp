@@ -1,8 +1,12 @@
-
 #pragma once
 
 #include "anyfin/base.hpp"
+#include "anyfin/arena.hpp"
+#include "anyfin/file_system.hpp"
+#include "anyfin/memory.hpp"
 #include "anyfin/platform.hpp"
+#include "anyfin/slice.hpp"
+#include "anyfin/strings.hpp"
 
 namespace Fin {
 
@@ -15,11 +19,103 @@ static Sys_Result<System_Command_Status> run_system_command (Memory_Arena &arena
 
 static Sys_Result<System_Command_Status> run_system_command (Memory_Arena &arena, String command_line);
 
+struct Command {
+  /*
+    Program followed by its arguments, which are passed to the child as is, without going through the shell.
+    Unless the program's path contains a separator, it's looked up in the directories listed in PATH.
+   */
+  Slice<String> arguments;
+
+  /*
+    Changes to the environment inherited from the current process: "NAME=value" sets the variable, while
+    "NAME" alone removes it.
+   */
+  Slice<String> environment;
+
+  /*
+    Directory the child starts in, inherits the current working directory if empty.
+   */
+  File_Path working_directory;
+
+  /*
+    Send the error output into the same stream as the standard output, preserving their relative order.
+   */
+  bool merge_error_output = false;
+};
+
+struct Command_Output {
+  String standard_output;
+  String error_output;
+
+  /*
+    Exit code of the child. If the child was terminated by a signal, it's reported as 128 + signal number,
+    same as shells do.
+   */
+  u32 status_code;
+};
+
+/*
+  Run the command, waiting for it to finish. Both output streams are captured in full and placed into the arena.
+ */
+static Sys_Result<Command_Output> run_command (Memory_Arena &arena, const Command &command);
+
+enum struct Output_Stream: u32 { Standard_Output, Error_Output };
+
+/*
+  Run the command, delivering its output as it arrives, line by line, to `on_output(Output_Stream, String line)`.
+  Lines don't include the line break, the last one is delivered at the end of the stream even if it's incomplete.
+
+  Each stream is buffered in `buffer_size` bytes taken from the arena, a line that doesn't fit is delivered in
+  parts. If `on_output` returns false, the child is killed and no more output is delivered.
+
+  Returns the child's status code, same as Command_Output's.
+ */
+static Sys_Result<u32> stream_command (Memory_Arena &arena, const Command &command, const auto &on_output, usize buffer_size = kilobytes(16));
+
+/*
+  Pending output of the streamed child, holds at most one incomplete line between reads.
+ */
+struct Stream_Buffer {
+  char  *memory;
+  usize  capacity;
+  usize  size;
+};
+
+/*
+  Hands complete lines from the buffer over to the callback, keeping the incomplete tail. Returns false once
+  the callback asks to stop.
+ */
+static bool deliver_lines (Stream_Buffer &buffer, Output_Stream stream, bool end_of_stream, const auto &on_output) {
+  const char *cursor = buffer.memory;
+  const char *end    = buffer.memory + buffer.size;
+
+  while (cursor < end) {
+    auto line_end = get_character_offset(cursor, end, '\n');
+    if (!line_end) break;
+
+    if (!on_output(stream, String(cursor, line_end - cursor))) return false;
+    cursor = line_end + 1;
+  }
+
+  usize remaining = end - cursor;
+  if (remaining && (end_of_stream || remaining == buffer.capacity)) {
+    if (!on_output(stream, String(cursor, remaining))) return false;
+    remaining = 0;
+  }
+
+  if (remaining && cursor != buffer.memory) move_memory(buffer.memory, cursor, remaining);
+  buffer.size = remaining;
+
+  return true;
+}
+
 }
 
 #ifndef FIN_COMMANDS_HPP_IMPL
   #ifdef PLATFORM_WIN32
     #include "anyfin/commands_win32.hpp"
+  #elif defined(PLATFORM_LINUX)
+    #include "anyfin/commands_linux.hpp"
   #else
     #error "Unsupported platform"
   #endif
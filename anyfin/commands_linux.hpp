@@ -0,0 +1,383 @@
+
+#define FIN_COMMANDS_HPP_IMPL
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "anyfin/arena.hpp"
+#include "anyfin/array.hpp"
+#include "anyfin/commands.hpp"
+#include "anyfin/defer.hpp"
+#include "anyfin/strings.hpp"
+
+extern char **environ;
+
+namespace Fin {
+
+struct Child_Process {
+  pid_t id;
+
+  int output; // Read ends of the child's output pipes, -1 once closed
+  int error;  // -1 from the start if the error output is merged
+};
+
+static bool is_overridden_variable (const char *variable, Slice<String> overrides) {
+  for (auto &entry: overrides) {
+    auto name_length = entry.length;
+    if (auto separator = get_character_offset(entry.value, entry.length, '='))
+      name_length = separator - entry.value;
+
+    usize matched = 0;
+    while (matched < name_length && variable[matched] == entry.value[matched]) matched += 1;
+
+    if (matched == name_length && variable[matched] == '=') return true;
+  }
+
+  return false;
+}
+
+/*
+  Arguments and the environment are prepared in the provided arena, which is taken by value, since the memory
+  isn't needed once the child has been started: posix_spawn returns after the child has called exec.
+ */
+static Sys_Result<Child_Process> spawn_child_process (Memory_Arena arena, const Command &command) {
+  fin_ensure(command.arguments.count > 0);
+
+  auto arguments = reserve_array<char *>(arena, command.arguments.count + 1);
+  if (!arguments.values) return System_Error { "not enough memory in the arena for the command's arguments", ENOMEM };
+
+  for (usize idx = 0; idx < command.arguments.count; idx++) {
+    // A missing copy would cut the argument list short and run a different command line.
+    auto argument = copy_string(arena, command.arguments[idx]);
+    if (!argument.value) return System_Error { "not enough memory in the arena for the command's arguments", ENOMEM };
+
+    arguments[idx] = const_cast<char *>(argument.value);
+  }
+  arguments[command.arguments.count] = nullptr;
+
+  auto environment = environ;
+  if (command.environment.count) {
+    usize inherited_count = 0;
+    while (environ[inherited_count]) inherited_count += 1;
+
+    auto variables = reserve_array<char *>(arena, inherited_count + command.environment.count + 1);
+    if (!variables.values) return System_Error { "not enough memory in the arena for the command's environment", ENOMEM };
+
+    usize count = 0;
+    for (usize idx = 0; idx < inherited_count; idx++) {
+      if (!is_overridden_variable(environ[idx], command.environment)) variables[count++] = environ[idx];
+    }
+
+    for (auto &entry: command.environment) {
+      if (!get_character_offset(entry.value, entry.length, '=')) continue;
+
+      auto variable = copy_string(arena, entry);
+      if (!variable.value) return System_Error { "not enough memory in the arena for the command's environment", ENOMEM };
+
+      variables[count++] = const_cast<char *>(variable.value);
+    }
+
+    variables[count] = nullptr;
+    environment = variables.values;
+  }
+
+  String working_directory;
+  if (!is_empty(command.working_directory)) {
+    working_directory = copy_string(arena, command.working_directory);
+    if (!working_directory.value) return System_Error { "not enough memory in the arena for the working directory", ENOMEM };
+  }
+
+  int output_pipe[2], error_pipe[2] = { -1, -1 };
+  if (pipe2(output_pipe, O_CLOEXEC) != 0) return get_system_error();
+  if (!command.merge_error_output && pipe2(error_pipe, O_CLOEXEC) != 0) {
+    auto error = get_system_error();
+    close(output_pipe[0]);
+    close(output_pipe[1]);
+    return error;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  defer { posix_spawn_file_actions_destroy(&actions); };
+
+  // Duplicated descriptors lose O_CLOEXEC, while the originals are closed on exec.
+  posix_spawn_file_actions_adddup2(&actions, output_pipe[1], STDOUT_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, command.merge_error_output ? output_pipe[1] : error_pipe[1], STDERR_FILENO);
+
+  if (!is_empty(working_directory)) posix_spawn_file_actions_addchdir_np(&actions, working_directory.value);
+
+  /*
+    The child shouldn't inherit the signal mask of whatever thread is spawning it, nor ignored SIGPIPE, which
+    runtimes commonly ignore, but most programs expect to be terminated by.
+   */
+  posix_spawnattr_t attributes;
+  posix_spawnattr_init(&attributes);
+  defer { posix_spawnattr_destroy(&attributes); };
+
+  sigset_t signal_mask, default_signals;
+  sigemptyset(&signal_mask);
+  sigemptyset(&default_signals);
+  sigaddset(&default_signals, SIGPIPE);
+
+  posix_spawnattr_setsigmask(&attributes, &signal_mask);
+  posix_spawnattr_setsigdefault(&attributes, &default_signals);
+  posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+  auto program = command.arguments[0];
+  auto spawn   = get_character_offset(program.value, program.length, '/') ? posix_spawn : posix_spawnp;
+
+  pid_t child_id;
+  auto status = spawn(&child_id, arguments[0], &actions, &attributes, arguments.values, environment);
+
+  close(output_pipe[1]);
+  if (error_pipe[1] >= 0) close(error_pipe[1]);
+
+  if (status != 0) {
+    close(output_pipe[0]);
+    if (error_pipe[0] >= 0) close(error_pipe[0]);
+
+    errno = status;
+    return get_system_error();
+  }
+
+  return Child_Process { child_id, output_pipe[0], error_pipe[0] };
+}
+
+/*
+  Output of a child's stream, accumulated in a separate mapping, since both streams are read concurrently
+  and couldn't grow in the caller's arena at the same time. The mapping is grown with mremap, which doesn't
+  copy the content.
+ */
+struct Output_Capture {
+  u8    *memory   = nullptr;
+  usize  capacity = 0;
+  usize  size     = 0;
+};
+
+static void destroy (Output_Capture &capture) {
+  if (capture.memory) munmap(capture.memory, capture.capacity);
+  capture = Output_Capture {};
+}
+
+/*
+  Read whatever is available in the pipe, the descriptor is closed and reset once the child closes its end.
+ */
+static Sys_Result<void> read_into_capture (Output_Capture &capture, int &descriptor) {
+  constexpr usize min_read_size = kilobytes(16);
+
+  if (capture.capacity - capture.size < min_read_size) {
+    auto new_capacity = capture.capacity ? capture.capacity * 2 : kilobytes(64);
+
+    auto memory = capture.memory
+      ? mremap(capture.memory, capture.capacity, new_capacity, MREMAP_MAYMOVE)
+      : mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return get_system_error();
+
+    capture.memory   = reinterpret_cast<u8 *>(memory);
+    capture.capacity = new_capacity;
+  }
+
+  auto bytes_read = read(descriptor, capture.memory + capture.size, capture.capacity - capture.size);
+  if (bytes_read < 0) {
+    if (errno == EINTR || errno == EAGAIN) return Ok();
+    return get_system_error();
+  }
+
+  if (bytes_read == 0) {
+    close(descriptor);
+    descriptor = -1;
+  }
+
+  capture.size += bytes_read;
+
+  return Ok();
+}
+
+static u32 get_status_code (int status) {
+  if (WIFEXITED(status))   return WEXITSTATUS(status);
+  if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+
+  return static_cast<u32>(-1);
+}
+
+static Sys_Result<u32> wait_for_child (Child_Process &child) {
+  int status = 0;
+  while (waitpid(child.id, &status, 0) < 0) {
+    if (errno != EINTR) return get_system_error();
+  }
+
+  return get_status_code(status);
+}
+
+static void close_child_streams (Child_Process &child) {
+  if (child.output >= 0) close(child.output);
+  if (child.error  >= 0) close(child.error);
+
+  child.output = -1;
+  child.error  = -1;
+}
+
+static Sys_Result<Command_Output> run_command (Memory_Arena &arena, const Command &command) {
+  auto [spawn_error, child] = spawn_child_process(arena, command);
+  if (spawn_error) return move(spawn_error.value);
+
+  Output_Capture output, error;
+  defer {
+    destroy(output);
+    destroy(error);
+  };
+
+  /*
+    If reading fails, the child is killed and reaped anyway, otherwise it'd be left as a zombie.
+   */
+  const auto abort_child = [&child] (System_Error failure) -> System_Error {
+    close_child_streams(child);
+    kill(child.id, SIGKILL);
+    wait_for_child(child);
+
+    return failure;
+  };
+
+  while (child.output >= 0 || child.error >= 0) {
+    pollfd streams[2] {
+      { .fd = child.output, .events = POLLIN },
+      { .fd = child.error,  .events = POLLIN },
+    };
+
+    if (poll(streams, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      return abort_child(get_system_error());
+    }
+
+    if (streams[0].revents) {
+      auto result = read_into_capture(output, child.output);
+      if (result.is_error()) return abort_child(move(result.error.value));
+    }
+
+    if (streams[1].revents) {
+      auto result = read_into_capture(error, child.error);
+      if (result.is_error()) return abort_child(move(result.error.value));
+    }
+  }
+
+  auto [wait_error, status_code] = wait_for_child(child);
+  if (wait_error) return move(wait_error.value);
+
+  auto standard_output = copy_string(arena, String(reinterpret_cast<char *>(output.memory), output.size));
+  auto error_output    = copy_string(arena, String(reinterpret_cast<char *>(error.memory),  error.size));
+  if (!standard_output.value || !error_output.value) return System_Error { "not enough memory in the arena for the command's output", ENOMEM };
+
+  return Command_Output {
+    .standard_output = standard_output,
+    .error_output    = error_output,
+    .status_code     = status_code,
+  };
+}
+
+static Sys_Result<u32> stream_command (Memory_Arena &arena, const Command &command, const auto &on_output, usize buffer_size) {
+  using enum Output_Stream;
+
+  fin_ensure(buffer_size > 0);
+
+  Stream_Buffer buffers[2] {
+    { .memory = reserve<char>(arena, buffer_size), .capacity = buffer_size },
+    { .memory = reserve<char>(arena, buffer_size), .capacity = buffer_size },
+  };
+  if (!buffers[0].memory || !buffers[1].memory)
+    return System_Error { "not enough memory in the arena for the output buffers", ENOMEM };
+
+  auto [spawn_error, child] = spawn_child_process(arena, command);
+  if (spawn_error) return move(spawn_error.value);
+
+  int *descriptors[2] { &child.output, &child.error };
+
+  while (child.output >= 0 || child.error >= 0) {
+    pollfd streams[2] {
+      { .fd = child.output, .events = POLLIN },
+      { .fd = child.error,  .events = POLLIN },
+    };
+
+    if (poll(streams, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+
+      auto error = get_system_error();
+      close_child_streams(child);
+      kill(child.id, SIGKILL);
+      wait_for_child(child);
+
+      return error;
+    }
+
+    for (usize idx = 0; idx < 2; idx++) {
+      if (!streams[idx].revents) continue;
+
+      auto &buffer     = buffers[idx];
+      auto &descriptor = *descriptors[idx];
+
+      auto bytes_read = read(descriptor, buffer.memory + buffer.size, buffer.capacity - buffer.size);
+      if (bytes_read < 0) {
+        if (errno == EINTR || errno == EAGAIN) continue;
+
+        auto error = get_system_error();
+        close_child_streams(child);
+        kill(child.id, SIGKILL);
+        wait_for_child(child);
+
+        return error;
+      }
+
+      buffer.size += bytes_read;
+
+      auto end_of_stream = (bytes_read == 0);
+      if (end_of_stream) {
+        close(descriptor);
+        descriptor = -1;
+      }
+
+      if (!deliver_lines(buffer, idx == 0 ? Standard_Output : Error_Output, end_of_stream, on_output)) {
+        // The child may be blocked writing into a full pipe, closing ours wouldn't be enough to stop it.
+        close_child_streams(child);
+        kill(child.id, SIGKILL);
+        break;
+      }
+    }
+  }
+
+  return wait_for_child(child);
+}
+
+/*
+  There's no default command to run without the command line, mirrors CreateProcess failing on Win32.
+ */
+static Sys_Result<System_Command_Status> run_system_command (Memory_Arena &arena) {
+  return System_Error { "command line is required", EINVAL };
+}
+
+/*
+  The command line is interpreted by the shell, both output streams are captured together.
+ */
+static Sys_Result<System_Command_Status> run_system_command (Memory_Arena &arena, String command_line) {
+  String arguments[] { "/bin/sh", "-c", command_line };
+
+  auto [error, result] = run_command(arena, Command {
+    .arguments          = Slice(arguments),
+    .merge_error_output = true,
+  });
+  if (error) return move(error.value);
+
+  // Same as the Win32 version, which drops the line break after the last line of output.
+  auto output = result.standard_output;
+  if (ends_with(output, "\n")) output.length -= 1;
+
+  return System_Command_Status {
+    .output      = output,
+    .status_code = result.status_code,
+  };
+}
+
+}
@@ -113,4 +113,398 @@ static Sys_Result<System_Command_Status> run_system_command (Memory_Arena &arena
   });
 }
 
+/*
+  Quoting rules of CommandLineToArgvW and the C runtime: backslashes are literal, unless they precede a quote.
+ */
+static String make_command_line (Memory_Arena &arena, Slice<String> arguments) {
+  usize capacity = 1;
+  for (auto &argument: arguments) capacity += 2 * argument.length + 3;
+
+  auto buffer = reserve<char>(arena, capacity);
+  fin_ensure(buffer);
+
+  usize length = 0;
+  for (auto &argument: arguments) {
+    if (length) buffer[length++] = ' ';
+
+    bool needs_quotes = is_empty(argument);
+    for (auto symbol: argument) needs_quotes |= (symbol == ' ' || symbol == '\t' || symbol == '"');
+
+    if (!needs_quotes) {
+      copy_memory(buffer + length, argument.value, argument.length);
+      length += argument.length;
+      continue;
+    }
+
+    buffer[length++] = '"';
+
+    usize backslashes = 0;
+    for (auto symbol: argument) {
+      if (symbol == '\\') {
+        backslashes += 1;
+        buffer[length++] = symbol;
+        continue;
+      }
+
+      if (symbol == '"') {
+        for (usize idx = 0; idx < backslashes + 1; idx++) buffer[length++] = '\\';
+      }
+
+      backslashes = 0;
+      buffer[length++] = symbol;
+    }
+
+    for (usize idx = 0; idx < backslashes; idx++) buffer[length++] = '\\';
+    buffer[length++] = '"';
+  }
+
+  buffer[length] = '\0';
+
+  return String(buffer, length);
+}
+
+static bool is_overridden_variable (String variable, Slice<String> overrides) {
+  for (auto &entry: overrides) {
+    auto name_length = entry.length;
+    if (auto separator = get_character_offset(entry.value, entry.length, '='))
+      name_length = separator - entry.value;
+
+    if (variable.length <= name_length || variable[name_length] != '=') continue;
+
+    // Names of environment variables are case-insensitive on Windows.
+    const auto to_lower = [] (char symbol) { return (symbol >= 'A' && symbol <= 'Z') ? char(symbol + ('a' - 'A')) : symbol; };
+
+    usize matched = 0;
+    while (matched < name_length && to_lower(variable[matched]) == to_lower(entry.value[matched])) matched += 1;
+
+    if (matched == name_length) return true;
+  }
+
+  return false;
+}
+
+/*
+  Environment block is a sequence of null-terminated "NAME=value" strings, ending with an empty string.
+ */
+static Sys_Result<char *> make_environment_block (Memory_Arena &arena, Slice<String> overrides) {
+  auto inherited = GetEnvironmentStringsA();
+  if (!inherited) return get_system_error();
+  defer { FreeEnvironmentStringsA(inherited); };
+
+  usize inherited_size = 0;
+  while (inherited[inherited_size] || inherited[inherited_size + 1]) inherited_size += 1;
+  inherited_size += 2;
+
+  usize capacity = inherited_size + 1;
+  for (auto &entry: overrides) capacity += entry.length + 1;
+
+  auto block = reserve<char>(arena, capacity);
+  if (!block) return System_Error { "not enough memory in the arena for the environment block", ERROR_NOT_ENOUGH_MEMORY };
+
+  usize length = 0;
+  for (auto cursor = inherited; *cursor;) {
+    auto variable = String(cast_bytes(cursor));
+    cursor += variable.length + 1;
+
+    if (is_overridden_variable(variable, overrides)) continue;
+
+    copy_memory(block + length, variable.value, variable.length + 1);
+    length += variable.length + 1;
+  }
+
+  for (auto &entry: overrides) {
+    if (!get_character_offset(entry.value, entry.length, '=')) continue;
+
+    copy_memory(block + length, entry.value, entry.length);
+    length += entry.length;
+    block[length++] = '\0';
+  }
+
+  block[length++] = '\0';
+
+  return block;
+}
+
+/*
+  Both output streams are read concurrently, each into its own reserved address range that's committed as the
+  output grows, since they couldn't grow in the caller's arena at the same time.
+ */
+struct Output_Capture {
+  u8    *memory    = nullptr;
+  usize  committed = 0;
+  usize  size      = 0;
+};
+
+constexpr usize output_capture_limit = megabytes(1024);
+
+static void destroy (Output_Capture &capture) {
+  if (capture.memory) VirtualFree(capture.memory, 0, MEM_RELEASE);
+  capture = Output_Capture {};
+}
+
+/*
+  Read whatever is available in the pipe, the handle is closed and reset once the child closes its end.
+ */
+static Sys_Result<bool> read_into_capture (Output_Capture &capture, HANDLE &pipe) {
+  DWORD bytes_available = 0;
+  if (!PeekNamedPipe(pipe, NULL, 0, NULL, &bytes_available, NULL)) {
+    if (get_system_error_code() != ERROR_BROKEN_PIPE) return get_system_error();
+
+    CloseHandle(pipe);
+    pipe = nullptr;
+
+    return false;
+  }
+
+  if (bytes_available == 0) return false;
+
+  if (!capture.memory) {
+    capture.memory = reinterpret_cast<u8 *>(VirtualAlloc(nullptr, output_capture_limit, MEM_RESERVE, PAGE_READWRITE));
+    if (!capture.memory) return get_system_error();
+  }
+
+  auto required = capture.size + bytes_available;
+  if (required > output_capture_limit) return System_Error { "child's output exceeds the capture limit", ERROR_NOT_ENOUGH_MEMORY };
+
+  if (required > capture.committed) {
+    auto commit_end = align_forward(required, kilobytes(64));
+    if (commit_end > output_capture_limit) commit_end = output_capture_limit;
+
+    if (!VirtualAlloc(capture.memory + capture.committed, commit_end - capture.committed, MEM_COMMIT, PAGE_READWRITE))
+      return get_system_error();
+
+    capture.committed = commit_end;
+  }
+
+  DWORD bytes_read = 0;
+  if (!ReadFile(pipe, capture.memory + capture.size, bytes_available, &bytes_read, NULL)) {
+    if (get_system_error_code() != ERROR_BROKEN_PIPE) return get_system_error();
+  }
+
+  capture.size += bytes_read;
+
+  return bytes_read > 0;
+}
+
+struct Child_Process {
+  HANDLE process;
+
+  HANDLE output; // Read ends of the child's output pipes, reset once closed
+  HANDLE error;  // Not created if the error output is merged
+};
+
+/*
+  Arguments and the environment are prepared in the provided arena, which is taken by value, since the memory
+  isn't needed once CreateProcess returns.
+ */
+static Sys_Result<Child_Process> spawn_child_process (Memory_Arena arena, const Command &command) {
+  fin_ensure(command.arguments.count > 0);
+
+  SECURITY_ATTRIBUTES security { .nLength = sizeof(SECURITY_ATTRIBUTES), .bInheritHandle = TRUE };
+
+  HANDLE output_read = nullptr, output_write = nullptr, error_read = nullptr, error_write = nullptr;
+  defer {
+    if (output_write) CloseHandle(output_write);
+    if (error_write)  CloseHandle(error_write);
+  };
+
+  const auto fail = [&] () -> System_Error {
+    auto error = get_system_error();
+
+    if (output_read) CloseHandle(output_read);
+    if (error_read)  CloseHandle(error_read);
+
+    return error;
+  };
+
+  if (!CreatePipe(&output_read, &output_write, &security, 0))          return fail();
+  if (!SetHandleInformation(output_read, HANDLE_FLAG_INHERIT, FALSE)) return fail();
+
+  if (!command.merge_error_output) {
+    if (!CreatePipe(&error_read, &error_write, &security, 0))          return fail();
+    if (!SetHandleInformation(error_read, HANDLE_FLAG_INHERIT, FALSE)) return fail();
+  }
+
+  STARTUPINFO info {
+    .cb         = sizeof(STARTUPINFO),
+    .dwFlags    = STARTF_USESTDHANDLES,
+    .hStdInput  = GetStdHandle(STD_INPUT_HANDLE),
+    .hStdOutput = output_write,
+    .hStdError  = command.merge_error_output ? output_write : error_write,
+  };
+
+  auto command_line = make_command_line(arena, command.arguments);
+
+  char *environment = nullptr;
+  if (command.environment.count) {
+    auto [error, block] = make_environment_block(arena, command.environment);
+    if (error) {
+      if (output_read) CloseHandle(output_read);
+      if (error_read)  CloseHandle(error_read);
+      return move(error.value);
+    }
+
+    environment = block;
+  }
+
+  const char *working_directory = nullptr;
+  if (!is_empty(command.working_directory)) working_directory = copy_string(arena, command.working_directory).value;
+
+  PROCESS_INFORMATION process {};
+  if (!CreateProcess(nullptr, const_cast<char *>(command_line.value), nullptr, nullptr, TRUE, 0,
+                     environment, working_directory, &info, &process))
+    return fail();
+
+  CloseHandle(process.hThread);
+
+  return Child_Process { process.hProcess, output_read, error_read };
+}
+
+static void close_child_streams (Child_Process &child) {
+  if (child.output) CloseHandle(child.output);
+  if (child.error)  CloseHandle(child.error);
+
+  child.output = nullptr;
+  child.error  = nullptr;
+}
+
+static Sys_Result<u32> wait_for_child (Child_Process &child) {
+  defer {
+    CloseHandle(child.process);
+    child.process = nullptr;
+  };
+
+  WaitForSingleObject(child.process, INFINITE);
+
+  DWORD exit_code = 0;
+  if (!GetExitCodeProcess(child.process, &exit_code)) return get_system_error();
+
+  return static_cast<u32>(exit_code);
+}
+
+static void abort_child (Child_Process &child) {
+  close_child_streams(child);
+  TerminateProcess(child.process, 1);
+  wait_for_child(child);
+}
+
+static Sys_Result<Command_Output> run_command (Memory_Arena &arena, const Command &command) {
+  auto [spawn_error, child] = spawn_child_process(arena, command);
+  if (spawn_error) return move(spawn_error.value);
+
+  Output_Capture output, error;
+  defer {
+    destroy(output);
+    destroy(error);
+  };
+
+  while (child.output || child.error) {
+    bool has_progress = false;
+
+    if (child.output) {
+      auto [read_error, has_read] = read_into_capture(output, child.output);
+      if (read_error) {
+        abort_child(child);
+        return move(read_error.value);
+      }
+
+      has_progress |= has_read;
+    }
+
+    if (child.error) {
+      auto [read_error, has_read] = read_into_capture(error, child.error);
+      if (read_error) {
+        abort_child(child);
+        return move(read_error.value);
+      }
+
+      has_progress |= has_read;
+    }
+
+    // Nothing to read yet, waiting for the child a little instead of spinning on the pipes.
+    if (!has_progress) WaitForSingleObject(child.process, 1);
+  }
+
+  auto [wait_error, status_code] = wait_for_child(child);
+  if (wait_error) return move(wait_error.value);
+
+  return Command_Output {
+    .standard_output = copy_string(arena, String(reinterpret_cast<char *>(output.memory), output.size)),
+    .error_output    = copy_string(arena, String(reinterpret_cast<char *>(error.memory),  error.size)),
+    .status_code     = status_code,
+  };
+}
+
+static Sys_Result<u32> stream_command (Memory_Arena &arena, const Command &command, const auto &on_output, usize buffer_size) {
+  using enum Output_Stream;
+
+  fin_ensure(buffer_size > 0);
+
+  Stream_Buffer buffers[2] {
+    { .memory = reserve<char>(arena, buffer_size), .capacity = buffer_size },
+    { .memory = reserve<char>(arena, buffer_size), .capacity = buffer_size },
+  };
+  if (!buffers[0].memory || !buffers[1].memory)
+    return System_Error { "not enough memory in the arena for the output buffers", ERROR_NOT_ENOUGH_MEMORY };
+
+  auto [spawn_error, child] = spawn_child_process(arena, command);
+  if (spawn_error) return move(spawn_error.value);
+
+  HANDLE *pipes[2] { &child.output, &child.error };
+
+  while (child.output || child.error) {
+    bool has_progress = false;
+
+    for (usize idx = 0; idx < 2; idx++) {
+      auto &buffer = buffers[idx];
+      auto &pipe   = *pipes[idx];
+      if (!pipe) continue;
+
+      bool end_of_stream = false;
+
+      DWORD bytes_available = 0;
+      if (!PeekNamedPipe(pipe, NULL, 0, NULL, &bytes_available, NULL)) {
+        if (get_system_error_code() != ERROR_BROKEN_PIPE) {
+          auto error = get_system_error();
+          abort_child(child);
+          return error;
+        }
+
+        CloseHandle(pipe);
+        pipe = nullptr;
+
+        end_of_stream = true;
+      }
+
+      if (bytes_available) {
+        auto free_space = buffer.capacity - buffer.size;
+
+        DWORD bytes_read = 0;
+        if (!ReadFile(pipe, buffer.memory + buffer.size, bytes_available < free_space ? bytes_available : free_space, &bytes_read, NULL)) {
+          if (get_system_error_code() != ERROR_BROKEN_PIPE) {
+            auto error = get_system_error();
+            abort_child(child);
+            return error;
+          }
+        }
+
+        buffer.size  += bytes_read;
+        has_progress |= bytes_read > 0;
+      }
+
+      if (!bytes_available && !end_of_stream) continue;
+
+      if (!deliver_lines(buffer, idx == 0 ? Standard_Output : Error_Output, end_of_stream, on_output)) {
+        close_child_streams(child);
+        TerminateProcess(child.process, 1);
+        break;
+      }
+    }
+
+    if (!has_progress && (child.output || child.error)) WaitForSingleObject(child.process, 1);
+  }
+
+  return wait_for_child(child);
+}
+
 }
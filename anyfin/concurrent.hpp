@@ -25,6 +25,55 @@ struct Spin_Lock {
   }
 };
 
+/*
+  Intrusive list of nodes registered by any number of threads and walked by a single consumer. Nodes must have
+  `abool is_retired` and `T *next` fields. Registration only prepends, which is safe to do concurrently with the
+  walk. Owners retire their nodes by setting `is_retired`, after which the consumer unlinks them, being the only
+  one that touches the links of nodes already in the list.
+ */
+template <typename T>
+struct Registered_List {
+  Atomic<T *> head;
+};
+
+template <typename T>
+static void register_node (Registered_List<T> &list, T *node) {
+  while (true) {
+    auto head = atomic_load<Memory_Order::Acquire>(list.head);
+    node->next = head;
+
+    if (atomic_compare_and_set(list.head, head, node)) break;
+  }
+}
+
+/*
+  Call `visit(T &)` on every node in the list, unlinking the retired ones afterwards. The retirement is checked
+  before the node is visited, so that everything its owner published prior to retiring is seen by the visit.
+  There must be a single consumer at a time.
+ */
+template <typename T>
+static void visit_registered_nodes (Registered_List<T> &list, const auto &visit) {
+  T *previous = nullptr;
+  for (auto node = atomic_load<Memory_Order::Acquire>(list.head); node;) {
+    auto is_retired = atomic_load<Memory_Order::Acquire>(node->is_retired);
+
+    visit(*node);
+
+    auto next = node->next;
+
+    if (!is_retired) previous = node;
+    else if (previous) previous->next = next;
+    else if (!atomic_compare_and_set(list.head, node, next)) {
+      // New nodes were prepended in the meantime, the predecessor is somewhere between them.
+      auto cursor = atomic_load<Memory_Order::Acquire>(list.head);
+      while (cursor->next != node) cursor = cursor->next;
+      cursor->next = next;
+    }
+
+    node = next;
+  }
+}
+
 struct Semaphore {
   struct Handle;
   Handle *handle;
@@ -42,6 +91,8 @@ static Sys_Result<void> wait_for_semaphore_signal (const Semaphore &sempahore);
 #ifndef FIN_CONCURRENT_HPP_IMPL
   #ifdef PLATFORM_WIN32
     #include "anyfin/concurrent_win32.hpp"
+  #elif defined(PLATFORM_LINUX)
+    #include "anyfin/concurrent_linux.hpp"
   #else
     #error "Unsupported platform"
   #endif
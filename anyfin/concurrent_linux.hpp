@@ -0,0 +1,60 @@
+
+#define FIN_CONCURRENT_HPP_IMPL
+
+#include <semaphore.h>
+#include <stdlib.h>
+
+#include "anyfin/concurrent.hpp"
+
+namespace Fin {
+
+/*
+  POSIX semaphores must stay at the same address while in use, thus the object is allocated separately.
+ */
+static Sys_Result<Semaphore> create_semaphore (u32 count) {
+  auto handle = static_cast<sem_t *>(malloc(sizeof(sem_t)));
+  if (!handle) return Error(System_Error { "failed to allocate the semaphore", ENOMEM });
+
+  if (sem_init(handle, 0, 0) != 0) {
+    free(handle);
+    return Error(get_system_error());
+  }
+
+  return Ok(Semaphore { reinterpret_cast<Semaphore::Handle *>(handle) });
+}
+
+static Sys_Result<void> destroy (Semaphore &semaphore) {
+  auto handle = reinterpret_cast<sem_t *>(semaphore.handle);
+
+  if (sem_destroy(handle) != 0) return Error(get_system_error());
+  free(handle);
+
+  semaphore.handle = nullptr;
+
+  return Ok();
+}
+
+static Sys_Result<u32> increment_semaphore (Semaphore &semaphore, u32 increment_value) {
+  auto handle = reinterpret_cast<sem_t *>(semaphore.handle);
+
+  int previous = 0;
+  if (sem_getvalue(handle, &previous) != 0) return Error(get_system_error());
+
+  for (u32 idx = 0; idx < increment_value; idx++) {
+    if (sem_post(handle) != 0) return Error(get_system_error());
+  }
+
+  return Ok<u32>(previous);
+}
+
+static Sys_Result<void> wait_for_semaphore_signal (const Semaphore &semaphore) {
+  auto handle = reinterpret_cast<sem_t *>(semaphore.handle);
+
+  while (sem_wait(handle) != 0) {
+    if (errno != EINTR) return Error(get_system_error());
+  }
+
+  return Ok();
+}
+
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/arena.hpp"
+#include "anyfin/array.hpp"
+#include "anyfin/defer.hpp"
+#include "anyfin/file_system.hpp"
+#include "anyfin/list.hpp"
+#include "anyfin/memory.hpp"
+#include "anyfin/prelude.hpp"
+#include "anyfin/sort.hpp"
+#include "anyfin/strings.hpp"
+
+namespace Fin {
+
+/*
+  Snapshot of the directory tree's files with their metadata, used to find out what has changed between runs.
+
+  Serialized form is the header, followed by the records sorted by their path and the blob with all paths,
+  which is exactly the in-memory layout, thus a saved snapshot is used directly from the mapped file.
+  Paths are relative to the snapshot's root directory.
+ */
+struct Snapshot_Record {
+  u64 id;
+  u64 size;
+  u64 last_update;
+
+  u32 path_offset;
+  u32 path_length;
+};
+
+struct Snapshot_Header {
+  u32 magic;
+  u32 version;
+  u64 records_count;
+  u64 strings_size;
+};
+
+constexpr u32 snapshot_magic   = 0x50534e46; // "FNSP"
+constexpr u32 snapshot_version = 1;
+
+struct Directory_Snapshot {
+  const Snapshot_Record *records = nullptr;
+  usize records_count = 0;
+
+  const char *strings = nullptr;
+  usize strings_size  = 0;
+
+  /*
+    Set only for snapshots loaded from a file, which must be released with destroy.
+   */
+  File         file    {};
+  File_Mapping mapping {};
+};
+
+fin_forceinline
+static String get_record_path (const Directory_Snapshot &snapshot, const Snapshot_Record &record) {
+  return String(snapshot.strings + record.path_offset, record.path_length);
+}
+
+/*
+  Walk the directory and record all files found under it. Records and paths are placed into the arena.
+ */
+static Sys_Result<Directory_Snapshot> take_snapshot (Memory_Arena &arena, File_Path root) {
+  auto [error, entries] = list_files_with_metadata(arena, root);
+  if (error) return move(error.value);
+
+  // All paths share the root's prefix, so sorting by the full path gives the order of relative paths.
+  sort(slice(entries), [] (const File_Entry &left, const File_Entry &right) {
+    return compare_strings(left.path, right.path) < 0;
+  });
+
+  auto prefix_length = root.length;
+  if (prefix_length && root[prefix_length - 1] != get_path_separator()) prefix_length += 1;
+
+  usize strings_size = 0;
+  for (auto &entry: entries) strings_size += entry.path.length - prefix_length;
+
+  if (strings_size > static_cast<u32>(-1)) return System_Error { "directory tree is too large for the snapshot", 0 };
+
+  auto records = reserve_array<Snapshot_Record>(arena, entries.count);
+  auto strings = reserve<char>(arena, strings_size ? strings_size : 1);
+  if ((entries.count && !records.values) || !strings)
+    return System_Error { "not enough memory in the arena for the snapshot", 0 };
+
+  usize offset = 0;
+  for (usize idx = 0; idx < entries.count; idx++) {
+    auto &entry = entries[idx];
+    auto  path  = String(entry.path.value + prefix_length, entry.path.length - prefix_length);
+
+    copy_memory(strings + offset, path.value, path.length);
+
+    records[idx] = Snapshot_Record {
+      .id          = entry.metadata.id,
+      .size        = entry.metadata.size,
+      .last_update = entry.metadata.last_update,
+      .path_offset = static_cast<u32>(offset),
+      .path_length = static_cast<u32>(path.length),
+    };
+
+    offset += path.length;
+  }
+
+  return Directory_Snapshot {
+    .records       = records.values,
+    .records_count = records.count,
+    .strings       = strings,
+    .strings_size  = strings_size,
+  };
+}
+
+static Sys_Result<void> save_snapshot (const Directory_Snapshot &snapshot, File_Path path) {
+  using enum File_System_Flags;
+
+  const Snapshot_Header header {
+    .magic         = snapshot_magic,
+    .version       = snapshot_version,
+    .records_count = snapshot.records_count,
+    .strings_size  = snapshot.strings_size,
+  };
+
+  String sections[] {
+    String(reinterpret_cast<const char *>(&header), sizeof(header)),
+    String(reinterpret_cast<const char *>(snapshot.records), snapshot.records_count * sizeof(Snapshot_Record)),
+    String(snapshot.strings, snapshot.strings_size),
+  };
+
+  auto [open_error, file] = open_file(path, Write_Access | Always_New);
+  if (open_error) return move(open_error.value);
+  defer { close_file(file); };
+
+  return write_gathered_to_file(file, Slice(sections));
+}
+
+/*
+  Map the previously saved snapshot into memory. The content is validated, so that a truncated or foreign file
+  results in an error rather than out of bounds reads.
+ */
+static Sys_Result<Directory_Snapshot> load_snapshot (File_Path path) {
+  auto [open_error, file] = open_file(path);
+  if (open_error) return move(open_error.value);
+
+  auto [map_error, mapping] = map_file_into_memory(file);
+  if (map_error) {
+    close_file(file);
+    return move(map_error.value);
+  }
+
+  auto snapshot = Directory_Snapshot { .file = file, .mapping = mapping };
+
+  const auto fail = [&] (const char *message) -> System_Error {
+    unmap_file(snapshot.mapping);
+    close_file(snapshot.file);
+
+    return System_Error { message, 0 };
+  };
+
+  if (mapping.size < sizeof(Snapshot_Header)) return fail("snapshot file is truncated");
+
+  auto header = reinterpret_cast<const Snapshot_Header *>(mapping.memory);
+  if (header->magic   != snapshot_magic)   return fail("file is not a directory snapshot");
+  if (header->version != snapshot_version) return fail("unsupported snapshot version");
+
+  auto records_size = mapping.size - sizeof(Snapshot_Header);
+  if (header->records_count > records_size / sizeof(Snapshot_Record)) return fail("snapshot file is truncated");
+
+  records_size = header->records_count * sizeof(Snapshot_Record);
+  if (mapping.size - sizeof(Snapshot_Header) - records_size != header->strings_size) return fail("snapshot file is truncated");
+
+  snapshot.records       = reinterpret_cast<const Snapshot_Record *>(mapping.memory + sizeof(Snapshot_Header));
+  snapshot.records_count = header->records_count;
+  snapshot.strings       = mapping.memory + sizeof(Snapshot_Header) + records_size;
+  snapshot.strings_size  = header->strings_size;
+
+  for (usize idx = 0; idx < snapshot.records_count; idx++) {
+    auto &record = snapshot.records[idx];
+    if (static_cast<u64>(record.path_offset) + record.path_length > snapshot.strings_size)
+      return fail("snapshot record points outside of the paths blob");
+  }
+
+  return snapshot;
+}
+
+static Sys_Result<void> destroy (Directory_Snapshot &snapshot) {
+  if (!snapshot.mapping.memory) return Ok();
+
+  fin_check(unmap_file(snapshot.mapping));
+  fin_check(close_file(snapshot.file));
+
+  snapshot = Directory_Snapshot {};
+
+  return Ok();
+}
+
+enum struct Snapshot_Change_Kind: u32 { Added, Removed, Modified };
+
+struct Snapshot_Change {
+  String               path; // Relative to the snapshot's root, points into the snapshot's memory
+  Snapshot_Change_Kind kind;
+};
+
+/*
+  Compare two snapshots of the same directory, reporting changes in the order of paths. The file is
+  considered modified when its size, last update timestamp or id (where available) are different, the latter
+  catches files that were replaced by another file with the same metadata.
+ */
+static List<Snapshot_Change> diff_snapshots (Memory_Arena &arena, const Directory_Snapshot &before, const Directory_Snapshot &after) {
+  using enum Snapshot_Change_Kind;
+
+  List<Snapshot_Change> changes { arena };
+
+  usize left = 0, right = 0;
+  while (left < before.records_count && right < after.records_count) {
+    auto &old_record = before.records[left];
+    auto &new_record = after.records[right];
+
+    auto old_path = get_record_path(before, old_record);
+    auto new_path = get_record_path(after,  new_record);
+
+    auto order = compare_strings(old_path, new_path);
+    if (order < 0) {
+      list_push(changes, Snapshot_Change { old_path, Removed });
+      left += 1;
+      continue;
+    }
+
+    if (order > 0) {
+      list_push(changes, Snapshot_Change { new_path, Added });
+      right += 1;
+      continue;
+    }
+
+    if (old_record.size        != new_record.size        ||
+        old_record.last_update != new_record.last_update ||
+        old_record.id          != new_record.id)
+      list_push(changes, Snapshot_Change { new_path, Modified });
+
+    left  += 1;
+    right += 1;
+  }
+
+  for (; left < before.records_count; left++)
+    list_push(changes, Snapshot_Change { get_record_path(before, before.records[left]), Removed });
+
+  for (; right < after.records_count; right++)
+    list_push(changes, Snapshot_Change { get_record_path(after, after.records[right]), Added });
+
+  return changes;
+}
+
+}
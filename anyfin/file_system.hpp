@@ -6,6 +6,7 @@
 #include "anyfin/bit_mask.hpp"
 #include "anyfin/memory.hpp"
 #include "anyfin/meta.hpp"
+#include "anyfin/slice.hpp"
 #include "anyfin/strings.hpp"
 #include "anyfin/platform.hpp"
 
@@ -67,6 +68,18 @@ enum struct File_System_Flags: u64 {
   Create_Missing = fin_flag(3),
   Always_New     = fin_flag(4),
   Force          = fin_flag(5),
+
+  /*
+    Bypass the page cache, transferring data directly between the storage and user buffers. Buffers, sizes and
+    file offsets must be aligned by get_direct_io_alignment, see reserve_direct_io_buffer.
+   */
+  Direct_IO      = fin_flag(6),
+
+  /*
+    Softer alternative to Direct_IO for data that's read or written only once. Works with regular buffers, but
+    the cached pages are dropped as the file is consumed, so that other processes' data isn't evicted.
+   */
+  Streaming      = fin_flag(7),
 };
 
 /*
@@ -144,11 +157,58 @@ static Sys_Result<void> for_each_file (File_Path directory, String extension, bo
 
 static Sys_Result<List<File_Path>> list_files (Memory_Arena &arena, File_Path directory, String extension = {}, bool recursive = false);
 
+struct File_Metadata {
+  u64 id;          // Same value as returned by get_file_id, zero if the listing doesn't provide it (Win32)
+  u64 size;
+  u64 last_update; // Same value as returned by get_last_update_timestamp
+  Resource_Type type;
+};
+
+struct File_Entry {
+  File_Path     path;
+  File_Metadata metadata;
+};
+
+/*
+  Recursively collect all files under the directory together with their metadata, which is obtained from the
+  directory listing itself without opening the files. Where supported, subdirectories are walked in parallel,
+  thus the order of entries is not specified.
+ */
+static Sys_Result<Array<File_Entry>> list_files_with_metadata (Memory_Arena &arena, File_Path directory);
+
+struct File_Status {
+  bool          exists;
+  File_Metadata metadata;
+
+  u32 error_code; // Platform's error code if the path couldn't be queried, `exists` is unset in that case
+};
+
+/*
+  Query metadata of multiple files at once, without opening them. Symbolic links are followed. Paths that don't
+  exist are reported with `exists` unset, other per-path failures (e.g no access) are recorded in the path's
+  `error_code`, thus one unreadable path doesn't fail the whole query. Results are placed into the arena in the
+  order of paths.
+ */
+static Sys_Result<Array<File_Status>> query_metadata (Memory_Arena &arena, Slice<File_Path> paths);
+
+/*
+  Copy the file's content into the destination file, which is replaced if it exists.
+ */
+static Sys_Result<void> copy_file (File_Path from, File_Path to);
+
+/*
+  Recursively copy the content of the directory into the destination, creating it if needed.
+ */
 static Sys_Result<void> copy_directory (File_Path from, File_Path to);
 
 struct File {
   void *handle;
   File_Path path;
+
+  Bit_Mask<File_System_Flags> flags {};
+
+  // Position of the file's cursor, maintained by cursor-based transfers for files opened in the Streaming mode.
+  u64 stream_cursor = 0;
 };
 
 static Sys_Result<File> open_file (File_Path path, Bit_Mask<File_System_Flags> flags = {});
@@ -170,14 +230,118 @@ static Sys_Result<void> write_bytes_to_file (File &file, Byte_Type auto (&data)[
   return write_bytes_to_file(file, data, N);
 }
 
+/*
+  Write all sections into the file in the given order, using a single vectored system call where the platform
+  supports it. Bytes are taken directly from the sections' memory, nothing is copied into intermediate buffers.
+ */
+static Sys_Result<void> write_gathered_to_file (File &file, Slice<String> sections);
+
 static Sys_Result<void> read_bytes_into_buffer (File &file, u8 *buffer, usize bytes_to_read);
 
+/*
+  Read at most `buffer_size` bytes with a single system call, returning the number of bytes read.
+  Unlike read_bytes_into_buffer this doesn't wait for the buffer to be filled, which is what pipes and
+  terminals need. Zero bytes read means the end of the stream has been reached.
+ */
+static Sys_Result<usize> read_available_bytes (File &file, u8 *buffer, usize buffer_size);
+
+/*
+  Files representing the standard streams of the current process. They are owned by the process and shouldn't
+  be closed by the caller.
+ */
+static File get_standard_input ();
+
+static File get_standard_output ();
+
+/*
+  Positional I/O that works at the given offset from the beginning of the file rather than the file's cursor.
+  Since there's no shared state involved, multiple threads can read or write disjoint ranges of the same
+  file through a single handle without any synchronization.
+
+  Reads return the number of bytes read, which is less than requested only if the end of the file has been
+  reached. Writes either transfer everything or fail.
+ */
+static Sys_Result<usize> read_bytes_at (const File &file, u64 offset, u8 *buffer, usize bytes_to_read);
+
+static Sys_Result<usize> read_bytes_at (const File &file, u64 offset, Slice<Array<u8>> buffers);
+
+static Sys_Result<void> write_bytes_at (const File &file, u64 offset, const u8 *bytes, usize count);
+
+static Sys_Result<void> write_bytes_at (const File &file, u64 offset, Slice<String> sections);
+
+static Sys_Result<void> write_bytes_at (const File &file, u64 offset, String data) {
+  return write_bytes_at(file, offset, cast_bytes<u8>(data.value), data.length);
+}
+
+enum struct Atomic_Write_Flags: u32 {
+  Sync_Data      = fin_flag(0), // Flush the content to the storage before the file is put into place
+  Sync_Metadata  = fin_flag(1), // Same as Sync_Data, also flushing metadata not needed to read the content back
+  Sync_Directory = fin_flag(2), // Flush the directory after the rename, which makes the replacement itself durable
+  No_Replace     = fin_flag(3), // Fail if the destination already exists instead of replacing it
+};
+
+constexpr auto default_atomic_write_flags = Atomic_Write_Flags::Sync_Data | Atomic_Write_Flags::Sync_Directory;
+
+struct Atomic_Write {
+  File_Path     path;
+  Slice<String> sections;
+};
+
+/*
+  Write each file's content into a temporary file next to the destination and rename it into place, thus
+  readers observe either the old file or the complete new one, never a partially written file, even if the
+  process crashes midway. Without sync flags the new content could still be lost on a power failure, though it
+  won't be observed partially written either.
+
+  Flushes of the batch's files are overlapped with each other and every directory is flushed once, after all
+  files of the batch are in place, which makes batches much cheaper than writing files one by one. Batches
+  spanning more than 256 directories flush them whenever that many are collected. Each file is replaced
+  atomically, but not the batch as a whole: if it fails midway, files renamed before the failure stay.
+ */
+static Sys_Result<void> write_files_atomically (Slice<Atomic_Write> files, Bit_Mask<Atomic_Write_Flags> flags = default_atomic_write_flags);
+
+static Sys_Result<void> write_file_atomically (File_Path path, Slice<String> sections, Bit_Mask<Atomic_Write_Flags> flags = default_atomic_write_flags) {
+  Atomic_Write file { path, sections };
+  return write_files_atomically(Slice(&file, 1), flags);
+}
+
+static Sys_Result<void> write_file_atomically (File_Path path, String content, Bit_Mask<Atomic_Write_Flags> flags = default_atomic_write_flags) {
+  return write_file_atomically(path, Slice(&content, 1), flags);
+}
+
 static Sys_Result<Array<u8>> get_file_content (Memory_Arena &arena, File &file);
 
 static Sys_Result<void> reset_file_cursor (File &file);
 
 static Sys_Result<u64> get_last_update_timestamp (const File &file);
 
+/*
+  Alignment required for buffers, transfer sizes and file offsets when working with files opened in Direct_IO mode.
+ */
+static usize get_direct_io_alignment ();
+
+static bool is_aligned_for_direct_io (const void *buffer, usize count, u64 offset = 0) {
+  const auto alignment = get_direct_io_alignment();
+
+  return is_aligned_by(reinterpret_cast<usize>(buffer), alignment) &&
+         is_aligned_by(count, alignment) &&
+         is_aligned_by(offset, alignment);
+}
+
+/*
+  Reserve a buffer usable for Direct_IO transfers, the size is rounded up to the required alignment.
+ */
+static Array<u8> reserve_direct_io_buffer (Memory_Arena &arena, usize size) {
+  const auto alignment = get_direct_io_alignment();
+  return reserve_array<u8>(arena, align_forward(size, alignment), alignment);
+}
+
+/*
+  Hint the system that the given range of the file won't be accessed again and its cached pages could be
+  released. With zero length the range extends till the end of the file.
+ */
+static Sys_Result<void> drop_file_cache (const File &file, u64 offset = 0, u64 length = 0);
+
 struct File_Mapping {
   void *handle;
   
@@ -194,6 +358,8 @@ static Sys_Result<void> unmap_file (File_Mapping &mapping);
 #ifndef FIN_FILE_SYSTEM_HPP_IMPL
   #ifdef PLATFORM_WIN32
     #include "anyfin/file_system_win32.hpp"
+  #elif defined(PLATFORM_LINUX)
+    #include "anyfin/file_system_linux.hpp"
   #else
     #error "Unsupported platform"
   #endif
@@ -0,0 +1,1737 @@
+
+#define FIN_FILE_SYSTEM_HPP_IMPL
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <linux/fs.h>
+#include <linux/io_uring.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "anyfin/arena.hpp"
+#include "anyfin/option.hpp"
+#include "anyfin/strings.hpp"
+#include "anyfin/meta.hpp"
+#include "anyfin/defer.hpp"
+#include "anyfin/atomics.hpp"
+#include "anyfin/concurrent.hpp"
+#include "anyfin/threads.hpp"
+
+#include "anyfin/file_system.hpp"
+
+namespace Fin {
+
+constexpr char get_path_separator() { return '/'; }
+
+constexpr String get_static_library_extension() { return "a"; }
+constexpr String get_shared_library_extension() { return "so"; }
+constexpr String get_executable_extension()     { return ""; }
+constexpr String get_object_extension()         { return "o"; }
+
+/*
+  On Linux the File's handle carries the file descriptor rather than a pointer.
+ */
+fin_forceinline
+static int get_file_descriptor (const File &file) {
+  return static_cast<int>(reinterpret_cast<usize>(file.handle));
+}
+
+fin_forceinline
+static void * make_file_handle (int descriptor) {
+  return reinterpret_cast<void *>(static_cast<usize>(descriptor));
+}
+
+/*
+  Paths coming from String slices are not guaranteed to be null-terminated, while all POSIX APIs expect
+  C strings, thus the path is copied into a stack buffer before each call.
+
+  Paths of PATH_MAX characters or longer are cut at PATH_MAX, which the kernel refuses with ENAMETOOLONG
+  before looking at the content, thus callers report such paths through their usual error handling.
+ */
+struct Path_Buffer {
+  char  value[PATH_MAX + 1];
+  usize length;
+
+  Path_Buffer (File_Path path)
+    : length { path.length < PATH_MAX ? path.length : PATH_MAX }
+  {
+    copy_memory(value, path.value, length);
+    value[length] = '\0';
+  }
+
+  operator const char * () const { return value; }
+};
+
+static bool is_directory_entry (DIR *directory, const dirent *entry) {
+  if (entry->d_type != DT_UNKNOWN) return entry->d_type == DT_DIR;
+
+  // Some file systems (e.g XFS without ftype) don't fill d_type, falling back to stat in that case.
+  struct stat info;
+  if (fstatat(dirfd(directory), entry->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0) return false;
+
+  return S_ISDIR(info.st_mode);
+}
+
+static bool is_special_entry (const dirent *entry) {
+  auto name = entry->d_name;
+  return (name[0] == '.') && ((name[1] == '\0') || (name[1] == '.' && name[2] == '\0'));
+}
+
+static Sys_Result<void> create_resource (File_Path path, const Resource_Type resource_type, const Bit_Mask<File_System_Flags> flags) {
+  switch (resource_type) {
+    case Resource_Type::File: {
+      auto descriptor = open(Path_Buffer(path), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0644);
+      if (descriptor < 0) return get_system_error();
+
+      close(descriptor);
+
+      return Ok();
+    }
+    case Resource_Type::Directory: {
+      Path_Buffer path_buffer { path };
+
+      if (mkdir(path_buffer, 0755) == 0) return Ok();
+
+      auto error_code = errno;
+      if (error_code == EEXIST) return Ok();
+      if (error_code != ENOENT) return get_system_error();
+
+      if (!flags.is_set(File_System_Flags::Force)) return get_system_error();
+
+      const auto create_recursive = [] (this auto self, char *path, usize length) -> Sys_Result<void> {
+        struct stat info;
+        if ((stat(path, &info) == 0) && S_ISDIR(info.st_mode)) return Ok();
+
+        auto separator = get_character_offset_reversed(path, length, '/');
+        if (separator && separator != path) {
+          *separator = '\0';
+          fin_check(self(path, separator - path));
+          *separator = '/';
+        }
+
+        if (mkdir(path, 0755) != 0) {
+          if (errno == EEXIST) return Ok();
+          return get_system_error();
+        }
+
+        return Ok();
+      };
+
+      return create_recursive(path_buffer.value, path_buffer.length);
+    }
+  }
+}
+
+static Sys_Result<bool> check_resource_exists (File_Path path, Resource_Type resource_type) {
+  struct stat info;
+  if (stat(Path_Buffer(path), &info) != 0) {
+    const auto error_code = get_system_error_code();
+    if ((error_code == ENOENT) || (error_code == ENOTDIR)) return false;
+
+    return get_system_error();
+  }
+
+  switch (resource_type) {
+    case Resource_Type::File:      return Ok(!S_ISDIR(info.st_mode));
+    case Resource_Type::Directory: return Ok(!!S_ISDIR(info.st_mode));
+  }
+}
+
+static Sys_Result<void> delete_resource (File_Path path, Resource_Type resource_type) {
+  switch (resource_type) {
+    case Resource_Type::File: {
+      if (unlink(Path_Buffer(path)) != 0) {
+        if (errno == ENOENT) return Ok();
+        return get_system_error();
+      }
+
+      return Ok();
+    }
+    case Resource_Type::Directory: {
+      if (rmdir(Path_Buffer(path)) == 0) return Ok();
+
+      auto error_code = errno;
+      if (error_code == ENOENT) return Ok();
+      if (error_code == ENOTEMPTY || error_code == EEXIST) {
+        auto delete_recursive = [] (this auto self, File_Path path) -> Sys_Result<void> {
+          auto directory = opendir(Path_Buffer(path));
+          if (!directory) return get_system_error();
+          defer { closedir(directory); };
+
+          while (true) {
+            errno = 0;
+            auto entry = readdir(directory);
+            if (!entry) {
+              if (errno) return get_system_error();
+              break;
+            }
+
+            if (is_special_entry(entry)) continue;
+
+            auto name = String(cast_bytes(entry->d_name));
+            if (path.length + 1 + name.length >= PATH_MAX) return System_Error { "path is too long", ENAMETOOLONG };
+
+            char buffer[PATH_MAX + 1];
+            Memory_Arena arena { buffer };
+
+            auto sub_path = make_file_path(arena, path, name);
+            fin_check(is_directory_entry(directory, entry) ? self(sub_path) : delete_file(sub_path));
+          }
+
+          if (rmdir(Path_Buffer(path)) != 0) {
+            fin_ensure(errno != ENOTEMPTY);
+            return get_system_error();
+          }
+
+          return Ok();
+        };
+
+        return delete_recursive(path);
+      }
+
+      return get_system_error();
+    }
+  }
+}
+
+static Sys_Result<String> get_resource_name (File_Path path) {
+  if (path.length >= PATH_MAX) return System_Error { "path is too long", ENAMETOOLONG };
+
+  auto separator = get_character_offset_reversed(path.value, path.length, '/');
+  if (!separator) return path;
+
+  auto after_separator = static_cast<usize>(separator - path.value) + 1;
+  return String(path.value + after_separator, path.length - after_separator);
+}
+
+static bool is_absolute_path (File_Path path) {
+  fin_ensure(!is_empty(path));
+
+  return path[0] == '/';
+}
+
+/*
+  Similar to GetFullPathName on Windows, this doesn't require the resource to exist, the path is resolved
+  against the current working directory without touching the file system.
+ */
+static Sys_Result<File_Path> get_absolute_path (Memory_Arena &arena, File_Path path) {
+  if (is_absolute_path(path)) return copy_string(arena, path);
+
+  char buffer[PATH_MAX];
+  if (!getcwd(buffer, PATH_MAX)) return get_system_error();
+
+  auto relative = path;
+  if (starts_with(relative, "./")) relative = relative + 2;
+
+  return concat_string(arena, String(cast_bytes(buffer)), "/", relative);
+}
+
+static Sys_Result<Resource_Type> get_resource_type (File_Path path) {
+  struct stat info;
+  if (stat(Path_Buffer(path), &info) != 0) return get_system_error();
+
+  return S_ISDIR(info.st_mode) ? Resource_Type::Directory : Resource_Type::File;
+};
+
+static Sys_Result<File_Path> get_folder_path (Memory_Arena &arena, File_Path path) {
+  if (path.length >= PATH_MAX) return System_Error { "path is too long", ENAMETOOLONG };
+
+  // Working directory, the separator and the path, each of them shorter than PATH_MAX.
+  char buffer[2 * PATH_MAX + 2];
+  Memory_Arena local { buffer };
+
+  auto [error, full_path] = get_absolute_path(local, path);
+  if (error) return move(error.value);
+
+  auto separator = get_character_offset_reversed(full_path.value, full_path.length, '/');
+  fin_ensure(separator);
+
+  auto folder_path_part_length = static_cast<usize>(separator - full_path.value);
+  if (folder_path_part_length == 0) folder_path_part_length = 1; // The file is located in the root directory
+
+  return copy_string(arena, String(full_path.value, folder_path_part_length));
+}
+
+static Sys_Result<File_Path> get_working_directory (Memory_Arena &arena) {
+  char buffer[PATH_MAX];
+  if (!getcwd(buffer, PATH_MAX)) return get_system_error();
+
+  return copy_string(arena, String(cast_bytes(buffer)));
+}
+
+static Sys_Result<void> set_working_directory (File_Path path) {
+  if (chdir(Path_Buffer(path)) != 0) return get_system_error();
+  return Ok();
+}
+
+static Sys_Result<void> for_each_file (File_Path directory, String extension, bool recursive, const Invocable<bool, File_Path> auto &func) {
+  auto run_visitor = [extension, recursive, func] (this auto self, File_Path directory) -> Sys_Result<bool> {
+    auto handle = opendir(Path_Buffer(directory));
+    if (!handle) return get_system_error();
+    defer { closedir(handle); };
+
+    while (true) {
+      errno = 0;
+      auto entry = readdir(handle);
+      if (!entry) {
+        if (errno) return get_system_error();
+        break;
+      }
+
+      if (is_special_entry(entry)) continue;
+
+      const auto file_name = String(cast_bytes(entry->d_name));
+      if (directory.length + 1 + file_name.length >= PATH_MAX) return System_Error { "path is too long", ENAMETOOLONG };
+
+      char buffer[PATH_MAX + 1];
+      Memory_Arena local { buffer };
+
+      if (is_directory_entry(handle, entry)) {
+        if (!recursive) continue;
+
+        auto [error, should_continue] = self(concat_string(local, directory, "/", file_name));
+        if (error)            return move(error.value);
+        if (!should_continue) return false;
+      }
+      else {
+        if (!ends_with(file_name, extension)) continue;
+        if (!func(concat_string(local, directory, "/", file_name))) return false;
+      }
+    }
+
+    return Ok(true);
+  };
+
+  fin_check(run_visitor(directory));
+
+  return Ok();
+}
+
+static Sys_Result<List<File_Path>> list_files (Memory_Arena &arena, File_Path directory, String extension, bool recursive) {
+  List<File_Path> file_list { arena };
+
+  auto list_recursive = [&] (this auto self, File_Path directory) -> Sys_Result<void> {
+    auto handle = opendir(Path_Buffer(directory));
+    if (!handle) return get_system_error();
+    defer { closedir(handle); };
+
+    while (true) {
+      errno = 0;
+      auto entry = readdir(handle);
+      if (!entry) {
+        if (errno) return get_system_error();
+        break;
+      }
+
+      if (is_special_entry(entry)) continue;
+
+      const auto file_name = String(cast_bytes(entry->d_name));
+
+      if (is_directory_entry(handle, entry)) {
+        if (recursive) fin_check(self(concat_string(arena, directory, "/", file_name)));
+      }
+      else {
+        if (!ends_with(file_name, extension)) continue;
+
+        auto file_path = concat_string(arena, directory, "/", file_name);
+        if (!file_list.contains(file_path)) list_push(file_list, move(file_path));
+      }
+    }
+
+    return Ok();
+  };
+
+  fin_check(list_recursive(directory));
+
+  return Ok(move(file_list));
+}
+
+static File_Metadata make_file_metadata (const struct stat &info) {
+  return File_Metadata {
+    .id          = static_cast<u64>(info.st_ino),
+    .size        = static_cast<u64>(info.st_size),
+    .last_update = static_cast<u64>(info.st_mtim.tv_sec) * 1'000'000'000ull + static_cast<u64>(info.st_mtim.tv_nsec),
+    .type        = S_ISDIR(info.st_mode) ? Resource_Type::Directory : Resource_Type::File,
+  };
+}
+
+/*
+  Directories are distributed between workers through a shared stack. Each worker lists a directory and stats
+  its entries relative to the directory's descriptor, accumulating them locally, so that the shared state is
+  touched once per batch of entries rather than for each one.
+ */
+static Sys_Result<Array<File_Entry>> list_files_with_metadata (Memory_Arena &arena, File_Path directory) {
+  struct Pending_Directory {
+    File_Path          path;
+    Pending_Directory *next;
+  };
+
+  struct Walk_Context {
+    Memory_Arena *arena;
+
+    Spin_Lock          lock;
+    Pending_Directory *pending;
+    List<File_Entry>   files;
+    usize              active_workers;
+    Option<System_Error> error;
+  };
+
+  struct Local_Entry {
+    String        name;
+    File_Metadata metadata;
+  };
+
+  constexpr usize local_batch_limit = 256;
+
+  // Alignment of reservations may take up to this much on top of the requested size.
+  constexpr usize alignment_slack = 64;
+
+  /*
+    Once the arena runs out, ENOMEM is recorded as the walk's error, which stops all workers. Returns false in
+    that case, so that the caller stops listing its directory.
+   */
+  const auto publish_entries = [] (Walk_Context *context, File_Path directory, Local_Entry *entries, usize count) -> bool {
+    context->lock.lock();
+    defer { context->lock.unlock(); };
+
+    for (usize idx = 0; idx < count; idx++) {
+      auto &entry = entries[idx];
+
+      // The path with its separator and terminator, followed by either the pending directory or the list node.
+      auto required = directory.length + entry.name.length + 2 + sizeof(Pending_Directory) + sizeof(List<File_Entry>::Node) + 2 * alignment_slack;
+      if (get_remaining_size(*context->arena) <= required) {
+        if (!context->error) context->error = System_Error { "not enough memory in the arena for the listed files", ENOMEM };
+        return false;
+      }
+
+      auto path = make_file_path(*context->arena, directory, entry.name);
+
+      if (entry.metadata.type == Resource_Type::Directory) {
+        auto pending = reserve<Pending_Directory>(*context->arena);
+        *pending = Pending_Directory { path, context->pending };
+        context->pending = pending;
+      }
+      else {
+        list_push(context->files, File_Entry { path, entry.metadata });
+      }
+    }
+
+    return true;
+  };
+
+  const auto walk_directory = [] (Walk_Context *context, File_Path directory, const auto &publish_entries) -> Sys_Result<void> {
+    auto handle = opendir(Path_Buffer(directory));
+    if (!handle) {
+      // Directory was removed while the tree is being walked, this is not an error.
+      if (errno == ENOENT) return Ok();
+      return get_system_error();
+    }
+    defer { closedir(handle); };
+
+    auto descriptor = dirfd(handle);
+
+    Local_Entry entries[local_batch_limit];
+    usize       count = 0;
+
+    char names_buffer[local_batch_limit * (NAME_MAX + 1)];
+    Memory_Arena names { names_buffer };
+
+    while (true) {
+      errno = 0;
+      auto entry = readdir(handle);
+      if (!entry) {
+        if (errno) return get_system_error();
+        break;
+      }
+
+      if (is_special_entry(entry)) continue;
+
+      auto &local = entries[count];
+      local.name = copy_string(names, String(cast_bytes(entry->d_name)));
+
+      if (entry->d_type == DT_DIR) {
+        local.metadata = File_Metadata { .type = Resource_Type::Directory };
+      }
+      else {
+        struct stat info;
+        if (fstatat(descriptor, entry->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+          if (errno == ENOENT) continue; // Removed after it was listed
+          return get_system_error();
+        }
+
+        local.metadata = make_file_metadata(info);
+      }
+
+      count += 1;
+
+      if (count == local_batch_limit) {
+        if (!publish_entries(context, directory, entries, count)) return Ok();
+
+        count = 0;
+        reset_arena(names);
+      }
+    }
+
+    if (count) publish_entries(context, directory, entries, count);
+
+    return Ok();
+  };
+
+  const auto walk_worker = [] (Walk_Context *context) {
+    constexpr auto publish = decltype(publish_entries) {};
+    constexpr auto walk    = decltype(walk_directory) {};
+
+    while (true) {
+      context->lock.lock();
+
+      if (context->error) {
+        context->lock.unlock();
+        return;
+      }
+
+      auto directory = context->pending;
+      if (directory) {
+        context->pending         = directory->next;
+        context->active_workers += 1;
+      }
+      else if (context->active_workers == 0) {
+        context->lock.unlock();
+        return;
+      }
+
+      context->lock.unlock();
+
+      if (!directory) {
+        // Other workers are still listing directories, which may yield more work.
+        sched_yield();
+        continue;
+      }
+
+      auto result = walk(context, directory->path, publish);
+
+      context->lock.lock();
+      context->active_workers -= 1;
+      if (result.is_error() && !context->error) context->error = move(result.error);
+      context->lock.unlock();
+    }
+  };
+
+  Walk_Context context {
+    .arena = &arena,
+    .files = List<File_Entry>(arena),
+  };
+
+  auto root      = reserve<Pending_Directory>(arena);
+  auto root_path = copy_string(arena, directory);
+  if (!root || !root_path.value) return System_Error { "not enough memory in the arena for the listed files", ENOMEM };
+
+  *root = Pending_Directory { root_path, nullptr };
+  context.pending = root;
+
+  constexpr usize workers_limit = 64;
+  usize workers_count = get_logical_cpu_count();
+  if (workers_count > workers_limit) workers_count = workers_limit;
+
+  Thread workers[workers_limit];
+  usize spawned_count = 0;
+
+  for (; spawned_count < workers_count - 1; spawned_count++) {
+    auto [error, thread] = spawn_thread(walk_worker, &context);
+    if (error) break;
+    workers[spawned_count] = thread;
+  }
+
+  walk_worker(&context);
+
+  // Every worker is joined before leaving, since those still running reference the context on this stack.
+  Sys_Result<void> status = Ok();
+  for (usize idx = 0; idx < spawned_count; idx++) {
+    auto result = wait_for_thread(workers[idx]);
+    if (result.is_error() && status.is_ok()) status = move(result);
+  }
+
+  fin_check(move(status));
+
+  if (context.error) return move(context.error.value);
+
+  auto result = reserve_array<File_Entry>(arena, context.files.count);
+  if (context.files.count && !result.values) return System_Error { "not enough memory in the arena for the listed files", ENOMEM };
+
+  usize index = 0;
+  for (auto &entry: context.files) result[index++] = entry;
+
+  return result;
+}
+
+static File_Metadata make_file_metadata (const struct statx &info) {
+  return File_Metadata {
+    .id          = static_cast<u64>(info.stx_ino),
+    .size        = static_cast<u64>(info.stx_size),
+    .last_update = static_cast<u64>(info.stx_mtime.tv_sec) * 1'000'000'000ull + static_cast<u64>(info.stx_mtime.tv_nsec),
+    .type        = S_ISDIR(info.stx_mode) ? Resource_Type::Directory : Resource_Type::File,
+  };
+}
+
+constexpr u32 metadata_query_mask = STATX_TYPE | STATX_MODE | STATX_INO | STATX_SIZE | STATX_MTIME;
+
+static void fill_file_status (File_Status &status, int result, const struct statx &info) {
+  if (result == -ENOENT || result == -ENOTDIR) {
+    status = File_Status { .exists = false };
+    return;
+  }
+
+  if (result < 0) {
+    status = File_Status { .exists = false, .error_code = static_cast<u32>(-result) };
+    return;
+  }
+
+  status = File_Status { .exists = true, .metadata = make_file_metadata(info) };
+}
+
+static void query_metadata_directly (File_Status &status, const char *path) {
+  struct statx info;
+  auto result = statx(AT_FDCWD, path, 0, metadata_query_mask, &info);
+
+  fill_file_status(status, result < 0 ? -errno : 0, info);
+}
+
+/*
+  Minimal io_uring setup for submitting batches of statx requests, which the kernel executes concurrently.
+ */
+struct Metadata_Ring {
+  int descriptor;
+
+  io_uring_params parameters;
+
+  void  *rings;
+  usize  rings_size;
+
+  io_uring_sqe *submissions;
+  usize         submissions_size;
+
+  u32 *submission_tail;
+  u32 *submission_mask;
+  u32 *submission_array;
+
+  u32          *completion_head;
+  u32          *completion_tail;
+  u32          *completion_mask;
+  io_uring_cqe *completions;
+};
+
+static bool create_metadata_ring (Metadata_Ring &ring, u32 entries) {
+  zero_memory(&ring);
+
+  ring.descriptor = static_cast<int>(syscall(__NR_io_uring_setup, entries, &ring.parameters));
+  if (ring.descriptor < 0) return false;
+
+  auto &parameters = ring.parameters;
+
+  // Kernels without a single mmap for both rings predate IORING_OP_STATX, no point in supporting them.
+  if (!(parameters.features & IORING_FEAT_SINGLE_MMAP)) {
+    close(ring.descriptor);
+    return false;
+  }
+
+  auto submissions_ring_size = parameters.sq_off.array + parameters.sq_entries * sizeof(u32);
+  auto completions_ring_size = parameters.cq_off.cqes  + parameters.cq_entries * sizeof(io_uring_cqe);
+
+  ring.rings_size = submissions_ring_size > completions_ring_size ? submissions_ring_size : completions_ring_size;
+  ring.rings      = mmap(nullptr, ring.rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.descriptor, IORING_OFF_SQ_RING);
+  if (ring.rings == MAP_FAILED) {
+    close(ring.descriptor);
+    return false;
+  }
+
+  ring.submissions_size = parameters.sq_entries * sizeof(io_uring_sqe);
+  auto submissions = mmap(nullptr, ring.submissions_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.descriptor, IORING_OFF_SQES);
+  if (submissions == MAP_FAILED) {
+    munmap(ring.rings, ring.rings_size);
+    close(ring.descriptor);
+    return false;
+  }
+
+  auto base = reinterpret_cast<u8 *>(ring.rings);
+
+  ring.submissions      = reinterpret_cast<io_uring_sqe *>(submissions);
+  ring.submission_tail  = reinterpret_cast<u32 *>(base + parameters.sq_off.tail);
+  ring.submission_mask  = reinterpret_cast<u32 *>(base + parameters.sq_off.ring_mask);
+  ring.submission_array = reinterpret_cast<u32 *>(base + parameters.sq_off.array);
+  ring.completion_head  = reinterpret_cast<u32 *>(base + parameters.cq_off.head);
+  ring.completion_tail  = reinterpret_cast<u32 *>(base + parameters.cq_off.tail);
+  ring.completion_mask  = reinterpret_cast<u32 *>(base + parameters.cq_off.ring_mask);
+  ring.completions      = reinterpret_cast<io_uring_cqe *>(base + parameters.cq_off.cqes);
+
+  return true;
+}
+
+static void destroy (Metadata_Ring &ring) {
+  munmap(ring.submissions, ring.submissions_size);
+  munmap(ring.rings, ring.rings_size);
+  close(ring.descriptor);
+}
+
+static Sys_Result<Array<File_Status>> query_metadata (Memory_Arena &arena, Slice<File_Path> paths) {
+  auto results = reserve_array<File_Status>(arena, paths.count);
+  if (paths.count && !results.values) return System_Error { "not enough memory in the arena for the query results", ENOMEM };
+
+  constexpr usize batch_limit = 256;
+
+  /*
+    Short queries aren't worth the ring's setup, same for systems where io_uring is missing or disabled.
+   */
+  Metadata_Ring ring;
+  if (paths.count < 8 || !create_metadata_ring(ring, batch_limit)) {
+    for (usize idx = 0; idx < paths.count; idx++) query_metadata_directly(results[idx], Path_Buffer(paths[idx]));
+
+    return results;
+  }
+  defer { destroy(ring); };
+
+  auto batch_size = ring.parameters.sq_entries < batch_limit ? ring.parameters.sq_entries : batch_limit;
+
+  // Requests are processed asynchronously, so all paths of the batch have to stay terminated at the same time.
+  auto local   = arena;
+  auto buffers = reserve_array<struct statx>(local, batch_size);
+  auto names   = reserve_array<char *>(local, batch_size);
+  if (!buffers.values || !names.values) return System_Error { "not enough memory in the arena for the query", ENOMEM };
+
+  for (usize offset = 0; offset < paths.count; offset += batch_size) {
+    auto count = (paths.count - offset) < batch_size ? (paths.count - offset) : batch_size;
+
+    auto names_arena = local;
+    auto tail        = *ring.submission_tail;
+
+    for (usize idx = 0; idx < count; idx++) {
+      auto &path = paths[offset + idx];
+
+      names[idx] = reserve<char>(names_arena, path.length + 1);
+      if (!names[idx]) return System_Error { "not enough memory in the arena for the query", ENOMEM };
+
+      copy_memory(names[idx], path.value, path.length);
+      names[idx][path.length] = '\0';
+
+      auto index = (tail + idx) & *ring.submission_mask;
+      auto &request = ring.submissions[index];
+
+      zero_memory(&request);
+      request.opcode      = IORING_OP_STATX;
+      request.fd          = AT_FDCWD;
+      request.addr        = reinterpret_cast<u64>(names[idx]);
+      request.len         = metadata_query_mask;
+      request.off         = reinterpret_cast<u64>(&buffers[idx]);
+      request.statx_flags = 0;
+      request.user_data   = idx;
+
+      ring.submission_array[index] = index;
+    }
+
+    __atomic_store_n(ring.submission_tail, tail + count, __ATOMIC_RELEASE);
+
+    /*
+      Requests taken by the kernel read `names` and write `buffers` asynchronously, even after the ring is closed,
+      thus once anything is submitted all of it has to complete before leaving, including on failures. Requests
+      left in the submission queue are never started.
+     */
+    Option<System_Error> failure;
+    usize submitted = 0, completed = 0;
+
+    while (completed < submitted || (!failure && submitted < count)) {
+      auto to_submit = failure ? 0 : count - submitted;
+
+      auto status = syscall(__NR_io_uring_enter, ring.descriptor, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (status < 0) {
+        if (errno == EINTR) continue;
+
+        // Waiting alone doesn't fail on a healthy ring, nothing could be reaped from it anymore.
+        if (failure) break;
+
+        failure = get_system_error();
+        continue;
+      }
+
+      submitted += static_cast<usize>(status);
+
+      auto head = *ring.completion_head;
+      auto end  = __atomic_load_n(ring.completion_tail, __ATOMIC_ACQUIRE);
+
+      for (; head != end; head++) {
+        auto &completion = ring.completions[head & *ring.completion_mask];
+        auto  idx        = static_cast<usize>(completion.user_data);
+
+        // Kernels before 5.6 don't know about IORING_OP_STATX.
+        if (completion.res == -EINVAL || completion.res == -EOPNOTSUPP) query_metadata_directly(results[offset + idx], names[idx]);
+        else                                                            fill_file_status(results[offset + idx], completion.res, buffers[idx]);
+
+        completed += 1;
+      }
+
+      __atomic_store_n(ring.completion_head, head, __ATOMIC_RELEASE);
+    }
+
+    if (failure) return move(failure.value);
+  }
+
+  return results;
+}
+
+/*
+  Copies the remaining content of the source descriptor into the destination, starting from the current
+  cursor positions of both, using a user-space buffer. Used when no kernel-side copy is available.
+ */
+static Sys_Result<void> copy_file_through_buffer (int source, int destination) {
+  auto region = reserve_virtual_memory(megabytes(1));
+  if (!region.memory) return get_system_error();
+  defer { free_virtual_memory(region); };
+
+  while (true) {
+    auto bytes_read = read(source, region.memory, region.size);
+    if (bytes_read < 0) {
+      if (errno == EINTR) continue;
+      return get_system_error();
+    }
+
+    if (bytes_read == 0) break;
+
+    ssize_t offset = 0;
+    while (offset < bytes_read) {
+      auto bytes_written = write(destination, region.memory + offset, bytes_read - offset);
+      if (bytes_written < 0) {
+        if (errno == EINTR) continue;
+        return get_system_error();
+      }
+
+      offset += bytes_written;
+    }
+  }
+
+  return Ok();
+}
+
+/*
+  Errors signaling that the kernel can't perform the copy between the given descriptors, e.g different file
+  systems or file types that don't support it, rather than an actual failure.
+ */
+static bool is_copy_unsupported (int error_code) {
+  return error_code == EXDEV  || error_code == EINVAL || error_code == ENOSYS ||
+         error_code == ENOTTY || error_code == EOPNOTSUPP;
+}
+
+/*
+  The copy is attempted in the order of cost, moving to the next strategy when the current one isn't supported:
+    1. FICLONE - shares the extents between files on CoW file systems (Btrfs, XFS), no data is copied.
+    2. copy_file_range - copy happens in kernel, may be offloaded to the storage (NFS, SMB).
+    3. sendfile - in-kernel copy through the page cache, works across file systems on older kernels.
+    4. Plain read/write through a large buffer.
+  Each step continues from the cursor positions where the previous one stopped.
+ */
+static Sys_Result<void> copy_file (File_Path from, File_Path to) {
+  auto source = open(Path_Buffer(from), O_RDONLY | O_CLOEXEC);
+  if (source < 0) return get_system_error();
+  defer { close(source); };
+
+  struct stat info;
+  if (fstat(source, &info) != 0) return get_system_error();
+
+  auto destination = open(Path_Buffer(to), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, info.st_mode & 0777);
+  if (destination < 0) return get_system_error();
+  defer { close(destination); };
+
+  // Files in pseudo file systems (e.g procfs) report zero size while having content.
+  if (info.st_size == 0) return copy_file_through_buffer(source, destination);
+
+  if (ioctl(destination, FICLONE, source) == 0) return Ok();
+  if (!is_copy_unsupported(errno)) return get_system_error();
+
+  auto remaining = static_cast<usize>(info.st_size);
+
+  while (remaining) {
+    auto bytes_copied = copy_file_range(source, nullptr, destination, nullptr, remaining, 0);
+    if (bytes_copied < 0) {
+      if (errno == EINTR) continue;
+      if (is_copy_unsupported(errno)) break;
+      return get_system_error();
+    }
+
+    if (bytes_copied == 0) break;
+    remaining -= (static_cast<usize>(bytes_copied) < remaining) ? bytes_copied : remaining;
+  }
+
+  while (remaining) {
+    auto bytes_copied = sendfile(destination, source, nullptr, remaining);
+    if (bytes_copied < 0) {
+      if (errno == EINTR) continue;
+      if (is_copy_unsupported(errno)) break;
+      return get_system_error();
+    }
+
+    if (bytes_copied == 0) break;
+    remaining -= (static_cast<usize>(bytes_copied) < remaining) ? bytes_copied : remaining;
+  }
+
+  /*
+    Either the file has grown since we've checked its size, or none of the kernel methods are supported.
+    In both cases the rest is copied until the end of the file is reached.
+   */
+  return copy_file_through_buffer(source, destination);
+}
+
+/*
+  Directories are created while walking the source tree, after which the files are copied in parallel,
+  since each copy is mostly waiting on the kernel or the storage.
+ */
+static Sys_Result<void> copy_directory (File_Path from, File_Path to) {
+  struct Copy_Task {
+    File_Path from;
+    File_Path to;
+  };
+
+  struct Copy_Context {
+    Array<Copy_Task> tasks;
+    ausize           next_task;
+
+    abool                error_claimed;
+    Option<System_Error> error;
+  };
+
+  /*
+    The number of entries isn't known until the walk is over, thus paths and tasks are placed into a chain of
+    regions, with the next one reserved whenever the current one runs out. Each region starts with the
+    descriptor of the previous one, earlier regions stay alive since paths and list nodes point into them.
+   */
+  constexpr usize region_size = megabytes(16);
+
+  Memory_Region region {};
+  defer {
+    while (region.memory) {
+      auto previous = *reinterpret_cast<Memory_Region *>(region.memory);
+      free_virtual_memory(region);
+      region = previous;
+    }
+  };
+
+  auto chain_region = [&region] (usize size) -> bool {
+    auto next = reserve_virtual_memory(sizeof(Memory_Region) + (size > region_size ? size : region_size));
+    if (!next.memory) return false;
+
+    *reinterpret_cast<Memory_Region *>(next.memory) = region;
+    region = next;
+
+    return true;
+  };
+
+  if (!chain_region(0)) return System_Error { "not enough memory to copy the directory", ENOMEM };
+
+  Memory_Arena arena { region.memory + sizeof(Memory_Region), region.size - sizeof(Memory_Region) };
+
+  // Alignment of reservations may take up to this much on top of the requested size.
+  constexpr usize alignment_slack = 64;
+
+  auto ensure_space = [&] (usize size) -> bool {
+    size += alignment_slack;
+    if (get_remaining_size(arena) > size) return true;
+
+    if (!chain_region(size)) return false;
+    arena = Memory_Arena { region.memory + sizeof(Memory_Region), region.size - sizeof(Memory_Region) };
+
+    return true;
+  };
+
+  List<Copy_Task> task_list { arena };
+
+  auto collect_recursive = [&] (this auto self, File_Path from, File_Path to) -> Sys_Result<void> {
+    auto handle = opendir(Path_Buffer(from));
+    if (!handle) return get_system_error();
+    defer { closedir(handle); };
+
+    while (true) {
+      errno = 0;
+      auto entry = readdir(handle);
+      if (!entry) {
+        if (errno) return get_system_error();
+        break;
+      }
+
+      if (is_special_entry(entry)) continue;
+
+      auto file_name = String(cast_bytes(entry->d_name));
+
+      // Both paths with their terminators and separators, followed by the task's list node.
+      auto entry_size = from.length + to.length + 2 * (file_name.length + 2) + sizeof(List<Copy_Task>::Node);
+      if (!ensure_space(entry_size)) return System_Error { "not enough memory to copy the directory", ENOMEM };
+
+      auto file_to_move = make_file_path(arena, from, file_name);
+      auto destination  = make_file_path(arena, to,   file_name);
+
+      if (is_directory_entry(handle, entry)) {
+        if (mkdir(Path_Buffer(destination), 0755) != 0 && errno != EEXIST) return get_system_error();
+        fin_check(self(file_to_move, destination));
+      }
+      else {
+        list_push(task_list, Copy_Task { file_to_move, destination });
+      }
+    }
+
+    return Ok();
+  };
+
+  fin_check(create_directory(to));
+  fin_check(collect_recursive(from, to));
+
+  if (is_empty(task_list)) return Ok();
+
+  Copy_Context context {};
+
+  if (!ensure_space(sizeof(Copy_Task) * task_list.count)) return System_Error { "not enough memory to copy the directory", ENOMEM };
+
+  context.tasks = reserve_array<Copy_Task>(arena, task_list.count);
+  {
+    usize index = 0;
+    for (auto &task: task_list) context.tasks[index++] = task;
+  }
+
+  const auto copy_worker = [] (Copy_Context *context) {
+    while (true) {
+      auto index = atomic_fetch_add(context->next_task, 1);
+      if (index >= context->tasks.count) return;
+
+      auto &task = context->tasks[index];
+      if (auto result = copy_file(task.from, task.to); result.is_error()) {
+        if (atomic_compare_and_set(context->error_claimed, false, true)) context->error = move(result.error);
+
+        // Stop handing out the remaining tasks.
+        atomic_store(context->next_task, context->tasks.count);
+        return;
+      }
+    }
+  };
+
+  constexpr usize workers_limit = 64;
+  usize workers_count = get_logical_cpu_count();
+  if (workers_count > task_list.count) workers_count = task_list.count;
+  if (workers_count > workers_limit)   workers_count = workers_limit;
+
+  Thread workers[workers_limit];
+  usize spawned_count = 0;
+
+  for (; spawned_count < workers_count - 1; spawned_count++) {
+    auto [error, thread] = spawn_thread(copy_worker, &context);
+    if (error) break; // The calling thread will carry the rest of the work.
+    workers[spawned_count] = thread;
+  }
+
+  copy_worker(&context);
+
+  // Every worker is joined before leaving, since those still running reference the context on this stack.
+  Sys_Result<void> status = Ok();
+  for (usize idx = 0; idx < spawned_count; idx++) {
+    auto result = wait_for_thread(workers[idx]);
+    if (result.is_error() && status.is_ok()) status = move(result);
+  }
+
+  fin_check(move(status));
+
+  if (context.error) return move(context.error.value);
+
+  return Ok();
+}
+
+static Sys_Result<File> open_file (File_Path path, Bit_Mask<File_System_Flags> flags) {
+  using enum File_System_Flags;
+
+  int mode = O_CLOEXEC | ((flags & Write_Access) ? O_RDWR : O_RDONLY);
+
+  if      (flags & Create_Missing) mode |= O_CREAT;
+  else if (flags & Always_New)     mode |= O_CREAT | O_TRUNC;
+
+  if (flags & Direct_IO) mode |= O_DIRECT;
+
+  auto descriptor = open(Path_Buffer(path), mode, 0644);
+  if (descriptor < 0) return get_system_error();
+
+  if (flags & Streaming) posix_fadvise(descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  return File { make_file_handle(descriptor), move(path), flags };
+}
+
+static Sys_Result<void> close_file (File &file) {
+  if (close(get_file_descriptor(file)) != 0) return get_system_error();
+  file.handle = nullptr;
+  return Ok();
+}
+
+static Sys_Result<u64> get_file_size (const File &file) {
+  struct stat info;
+  if (fstat(get_file_descriptor(file), &info) != 0) return get_system_error();
+
+  return static_cast<u64>(info.st_size);
+}
+
+static Sys_Result<u64> get_file_id (const File &file) {
+  struct stat info;
+  if (fstat(get_file_descriptor(file), &info) != 0) return get_system_error();
+
+  return static_cast<u64>(info.st_ino);
+}
+
+static usize get_direct_io_alignment () {
+  /*
+    The kernel requires the logical block size alignment of the underlying device, which never exceeds the
+    page size on supported configurations.
+   */
+  return static_cast<usize>(sysconf(_SC_PAGESIZE));
+}
+
+/*
+  The kernel rejects misaligned Direct_IO transfers with a bare EINVAL, which is checked upfront instead to
+  report what's actually wrong.
+ */
+static Sys_Result<void> check_direct_io_transfer (const File &file, const void *buffer, usize count, u64 offset = 0) {
+  if (!(file.flags & File_System_Flags::Direct_IO)) return Ok();
+
+  if (!is_aligned_for_direct_io(buffer, count, offset))
+    return System_Error { "Direct_IO buffer address, transfer size and file offset must be aligned by get_direct_io_alignment()", EINVAL };
+
+  return Ok();
+}
+
+static Sys_Result<void> check_direct_io_transfer (const File &file, Slice<String> sections, u64 offset = 0) {
+  if (!(file.flags & File_System_Flags::Direct_IO)) return Ok();
+
+  for (auto &section: sections) fin_check(check_direct_io_transfer(file, section.value, section.length, offset));
+
+  return Ok();
+}
+
+static Sys_Result<void> drop_file_cache (const File &file, u64 offset, u64 length) {
+  if (auto status = posix_fadvise(get_file_descriptor(file), offset, length, POSIX_FADV_DONTNEED); status != 0) {
+    errno = status;
+    return get_system_error();
+  }
+
+  return Ok();
+}
+
+/*
+  For files opened in the Streaming mode, releases the cached pages of the range that has just been transferred.
+  Dirty pages can't be dropped, thus for writes only the writeback of the new range is initiated. The pages
+  written one window earlier are waited for and released instead, so that a window of writeback stays in flight
+  and the writer isn't stalled on the range it has just submitted.
+ */
+static void release_streamed_range (const File &file, u64 offset, usize count, bool written) {
+  if (!(file.flags & File_System_Flags::Streaming) || count == 0) return;
+
+  auto descriptor = get_file_descriptor(file);
+
+  if (!written) {
+    posix_fadvise(descriptor, offset, count, POSIX_FADV_DONTNEED);
+    return;
+  }
+
+  sync_file_range(descriptor, offset, count, SYNC_FILE_RANGE_WRITE);
+
+  constexpr u64 writeback_window = megabytes(8);
+
+  auto end = offset + count;
+  if (end <= writeback_window) return;
+
+  auto release_start = offset > writeback_window ? offset - writeback_window : 0;
+  auto release_count = end - writeback_window - release_start;
+
+  sync_file_range(descriptor, release_start, release_count, SYNC_FILE_RANGE_WAIT_BEFORE);
+  posix_fadvise(descriptor, release_start, release_count, POSIX_FADV_DONTNEED);
+}
+
+/*
+  Same as above for calls that work with the file's cursor, which is advanced past the transferred range.
+ */
+static void release_streamed_bytes (File &file, usize count, bool written) {
+  if (!(file.flags & File_System_Flags::Streaming) || count == 0) return;
+
+  auto offset = file.stream_cursor;
+  file.stream_cursor += count;
+
+  release_streamed_range(file, offset, count, written);
+}
+
+static Sys_Result<void> write_bytes_to_file (File &file, Byte_Type auto *bytes, usize count) {
+  fin_check(check_direct_io_transfer(file, bytes, count));
+
+  auto descriptor = get_file_descriptor(file);
+
+  usize total_bytes_written = 0;
+  while (total_bytes_written < count) {
+    auto bytes_written = write(descriptor, bytes + total_bytes_written, count - total_bytes_written);
+    if (bytes_written < 0) {
+      if (errno == EINTR) continue;
+      return get_system_error();
+    }
+
+    total_bytes_written += bytes_written;
+  }
+
+  release_streamed_bytes(file, count, true);
+
+  return Ok();
+}
+
+/*
+  Vectored calls may transfer only a part of the requested data. Skips the segments that have been fully
+  transferred and adjusts the first partially transferred one, so the call could be repeated.
+ */
+static void advance_io_vectors (iovec *&cursor, usize &count, usize bytes_transferred) {
+  while (count && bytes_transferred >= cursor->iov_len) {
+    bytes_transferred -= cursor->iov_len;
+    cursor            += 1;
+    count             -= 1;
+  }
+
+  if (count) {
+    cursor->iov_base  = static_cast<u8 *>(cursor->iov_base) + bytes_transferred;
+    cursor->iov_len  -= bytes_transferred;
+  }
+}
+
+/*
+  The kernel limits the number of segments per call by IOV_MAX, thus segments are submitted in batches.
+  The batch is a copy, so that partially transferred segments could be adjusted without touching caller's data.
+ */
+constexpr usize io_vectors_batch_limit = 64;
+
+static usize fill_io_vectors (iovec (&batch)[io_vectors_batch_limit], Slice<String> sections) {
+  usize count = 0;
+  for (; count < io_vectors_batch_limit && count < sections.count; count++) {
+    batch[count] = iovec {
+      .iov_base = const_cast<char *>(sections.values[count].value),
+      .iov_len  = sections.values[count].length,
+    };
+  }
+
+  return count;
+}
+
+static Sys_Result<void> write_gathered_to_file (File &file, Slice<String> sections) {
+  fin_check(check_direct_io_transfer(file, sections));
+
+  auto descriptor = get_file_descriptor(file);
+
+  iovec batch[io_vectors_batch_limit];
+
+  usize total_bytes_written = 0;
+  while (sections.count) {
+    auto count = fill_io_vectors(batch, sections);
+    sections += count;
+
+    auto cursor = batch;
+    while (count) {
+      auto bytes_written = writev(descriptor, cursor, count);
+      if (bytes_written < 0) {
+        if (errno == EINTR) continue;
+        return get_system_error();
+      }
+
+      total_bytes_written += bytes_written;
+      advance_io_vectors(cursor, count, bytes_written);
+    }
+  }
+
+  release_streamed_bytes(file, total_bytes_written, true);
+
+  return Ok();
+}
+
+static Sys_Result<usize> read_bytes_at (const File &file, u64 offset, u8 *buffer, usize bytes_to_read) {
+  fin_ensure(buffer);
+  fin_check(check_direct_io_transfer(file, buffer, bytes_to_read, offset));
+
+  auto descriptor = get_file_descriptor(file);
+
+  usize total_bytes_read = 0;
+  while (total_bytes_read < bytes_to_read) {
+    auto bytes_read = pread(descriptor, buffer + total_bytes_read, bytes_to_read - total_bytes_read, offset + total_bytes_read);
+    if (bytes_read < 0) {
+      if (errno == EINTR) continue;
+      return get_system_error();
+    }
+
+    if (bytes_read == 0) break;
+
+    total_bytes_read += bytes_read;
+  }
+
+  release_streamed_range(file, offset, total_bytes_read, false);
+
+  return total_bytes_read;
+}
+
+static Sys_Result<usize> read_bytes_at (const File &file, u64 offset, Slice<Array<u8>> buffers) {
+  auto descriptor = get_file_descriptor(file);
+
+  iovec batch[io_vectors_batch_limit];
+
+  usize total_bytes_read = 0;
+  while (buffers.count) {
+    usize count = 0;
+    for (; count < io_vectors_batch_limit && count < buffers.count; count++) {
+      batch[count] = iovec { .iov_base = buffers.values[count].values, .iov_len = buffers.values[count].count };
+    }
+
+    buffers += count;
+
+    if (file.flags & File_System_Flags::Direct_IO) {
+      for (usize idx = 0; idx < count; idx++)
+        fin_check(check_direct_io_transfer(file, batch[idx].iov_base, batch[idx].iov_len, offset));
+    }
+
+    auto cursor = batch;
+    while (count) {
+      auto bytes_read = preadv(descriptor, cursor, count, offset + total_bytes_read);
+      if (bytes_read < 0) {
+        if (errno == EINTR) continue;
+        return get_system_error();
+      }
+
+      if (bytes_read == 0) {
+        release_streamed_range(file, offset, total_bytes_read, false);
+        return total_bytes_read;
+      }
+
+      total_bytes_read += bytes_read;
+      advance_io_vectors(cursor, count, bytes_read);
+    }
+  }
+
+  release_streamed_range(file, offset, total_bytes_read, false);
+
+  return total_bytes_read;
+}
+
+static Sys_Result<void> write_bytes_at (const File &file, u64 offset, const u8 *bytes, usize count) {
+  fin_check(check_direct_io_transfer(file, bytes, count, offset));
+
+  auto descriptor = get_file_descriptor(file);
+
+  usize total_bytes_written = 0;
+  while (total_bytes_written < count) {
+    auto bytes_written = pwrite(descriptor, bytes + total_bytes_written, count - total_bytes_written, offset + total_bytes_written);
+    if (bytes_written < 0) {
+      if (errno == EINTR) continue;
+      return get_system_error();
+    }
+
+    total_bytes_written += bytes_written;
+  }
+
+  release_streamed_range(file, offset, count, true);
+
+  return Ok();
+}
+
+static Sys_Result<void> write_bytes_at (const File &file, u64 offset, Slice<String> sections) {
+  fin_check(check_direct_io_transfer(file, sections, offset));
+
+  auto descriptor = get_file_descriptor(file);
+  auto start      = offset;
+
+  iovec batch[io_vectors_batch_limit];
+
+  while (sections.count) {
+    auto count = fill_io_vectors(batch, sections);
+    sections += count;
+
+    auto cursor = batch;
+    while (count) {
+      auto bytes_written = pwritev(descriptor, cursor, count, offset);
+      if (bytes_written < 0) {
+        if (errno == EINTR) continue;
+        return get_system_error();
+      }
+
+      offset += bytes_written;
+      advance_io_vectors(cursor, count, bytes_written);
+    }
+  }
+
+  release_streamed_range(file, start, offset - start, true);
+
+  return Ok();
+}
+
+static Sys_Result<void> read_bytes_into_buffer (File &file, u8 *buffer, usize bytes_to_read) {
+  fin_ensure(buffer);
+  fin_ensure(bytes_to_read > 0);
+
+  fin_check(check_direct_io_transfer(file, buffer, bytes_to_read));
+
+  auto descriptor = get_file_descriptor(file);
+
+  usize offset = 0;
+  while (offset < bytes_to_read) {
+    auto bytes_read = read(descriptor, buffer + offset, bytes_to_read - offset);
+    if (bytes_read < 0) {
+      if (errno == EINTR) continue;
+      return get_system_error();
+    }
+
+    if (bytes_read == 0) return System_Error { "unexpected end of file", EIO };
+
+    offset += bytes_read;
+  }
+
+  release_streamed_bytes(file, bytes_to_read, false);
+
+  return Ok();
+}
+
+static Sys_Result<usize> read_available_bytes (File &file, u8 *buffer, usize buffer_size) {
+  fin_ensure(buffer);
+  fin_check(check_direct_io_transfer(file, buffer, buffer_size));
+
+  while (true) {
+    auto bytes_read = read(get_file_descriptor(file), buffer, buffer_size);
+    if (bytes_read < 0) {
+      if (errno == EINTR) continue;
+      return get_system_error();
+    }
+
+    release_streamed_bytes(file, bytes_read, false);
+
+    return static_cast<usize>(bytes_read);
+  }
+}
+
+static File get_standard_input () {
+  return File { make_file_handle(STDIN_FILENO), "stdin" };
+}
+
+static File get_standard_output () {
+  return File { make_file_handle(STDOUT_FILENO), "stdout" };
+}
+
+static String get_parent_directory (File_Path path) {
+  for (usize idx = path.length; idx > 0; idx--) {
+    if (path[idx - 1] == '/') return String(path.value, idx > 1 ? idx - 1 : 1);
+  }
+
+  return ".";
+}
+
+/*
+  File written as part of write_files_atomically, which isn't visible under the destination's path yet.
+ */
+struct Staged_File {
+  int  descriptor;
+  bool anonymous; // Created with O_TMPFILE, doesn't have a name until it's linked into the directory
+  bool linked;
+
+  // Distinguishes the temporary sibling's name, which is rendered on demand rather than kept for the whole group.
+  u32 sequence;
+};
+
+static Sys_Result<void> make_temporary_path (char (&buffer)[PATH_MAX], File_Path path, u32 sequence) {
+  if (path.length + 48 >= PATH_MAX) return System_Error { "path is too long for a temporary sibling", ENAMETOOLONG };
+
+  usize length = 0;
+
+  const auto append = [&] (String part) {
+    copy_memory(buffer + length, part.value, part.length);
+    length += part.length;
+  };
+
+  const auto append_number = [&] (u64 value) {
+    char digits[20];
+    usize count = 0;
+
+    do {
+      digits[count++] = '0' + (value % 10);
+      value /= 10;
+    } while (value);
+
+    while (count) buffer[length++] = digits[--count];
+  };
+
+  append(path);
+  append(".");
+  append_number(static_cast<u64>(getpid()));
+  append(".");
+  append_number(sequence);
+  append(".tmp");
+
+  buffer[length] = '\0';
+
+  return Ok();
+}
+
+static void discard_staged_file (Staged_File &staged, File_Path path) {
+  if (staged.descriptor >= 0) close(staged.descriptor);
+
+  if (!staged.anonymous || staged.linked) {
+    char temporary_path[PATH_MAX];
+    if (make_temporary_path(temporary_path, path, staged.sequence).is_ok()) unlink(temporary_path);
+  }
+
+  staged.descriptor = -1;
+}
+
+static Sys_Result<void> stage_atomic_write (Staged_File &staged, const Atomic_Write &write, Bit_Mask<Atomic_Write_Flags> flags, bool use_anonymous_files) {
+  using enum Atomic_Write_Flags;
+
+  static au32 counter;
+
+  staged.descriptor = -1;
+  staged.anonymous  = false;
+  staged.linked     = false;
+  staged.sequence   = atomic_fetch_add(counter, 1);
+
+  char temporary_path[PATH_MAX];
+  fin_check(make_temporary_path(temporary_path, write.path, staged.sequence));
+
+  if (use_anonymous_files) {
+    staged.descriptor = open(Path_Buffer(get_parent_directory(write.path)), O_TMPFILE | O_WRONLY | O_CLOEXEC, 0644);
+    staged.anonymous  = (staged.descriptor >= 0);
+  }
+
+  // Not all file systems support O_TMPFILE, named temporary file is used instead.
+  if (!staged.anonymous) {
+    staged.descriptor = open(temporary_path, O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0644);
+    if (staged.descriptor < 0) return get_system_error();
+  }
+
+  auto file = File { make_file_handle(staged.descriptor), write.path };
+
+  auto result = write_gathered_to_file(file, write.sections);
+  if (result.is_error()) {
+    discard_staged_file(staged, write.path);
+    return result;
+  }
+
+  // Start the writeback right away, so that flushes of the batch's files overlap.
+  if ((flags & Sync_Data) || (flags & Sync_Metadata)) sync_file_range(staged.descriptor, 0, 0, SYNC_FILE_RANGE_WRITE);
+
+  return Ok();
+}
+
+static Sys_Result<void> commit_atomic_write (Staged_File &staged, File_Path path, Bit_Mask<Atomic_Write_Flags> flags) {
+  using enum Atomic_Write_Flags;
+
+  const auto fail = [&staged, path] () -> System_Error {
+    auto error = get_system_error();
+    discard_staged_file(staged, path);
+    return error;
+  };
+
+  char temporary_path[PATH_MAX];
+  if (auto result = make_temporary_path(temporary_path, path, staged.sequence); result.is_error()) {
+    discard_staged_file(staged, path);
+    return result;
+  }
+
+  if      (flags & Sync_Metadata) { if (fsync(staged.descriptor)     != 0) return fail(); }
+  else if (flags & Sync_Data)     { if (fdatasync(staged.descriptor) != 0) return fail(); }
+
+  if (staged.anonymous) {
+    const String prefix = "/proc/self/fd/";
+
+    char digits[24];
+    auto number = render_unsigned(digits, static_cast<u64>(staged.descriptor));
+
+    char descriptor_path[64];
+    copy_memory(descriptor_path, prefix.value, prefix.length);
+    copy_memory(descriptor_path + prefix.length, number.value, number.length);
+    descriptor_path[prefix.length + number.length] = '\0';
+
+    if (linkat(AT_FDCWD, descriptor_path, AT_FDCWD, temporary_path, AT_SYMLINK_FOLLOW) != 0) return fail();
+    staged.linked = true;
+  }
+
+  close(staged.descriptor);
+  staged.descriptor = -1;
+
+  Path_Buffer destination { path };
+
+  if (flags & No_Replace) {
+    if (renameat2(AT_FDCWD, temporary_path, AT_FDCWD, destination, RENAME_NOREPLACE) == 0) return Ok();
+
+    // File systems that don't support the flag, linking fails just the same if the destination exists.
+    if (errno != EINVAL) return fail();
+    if (link(temporary_path, destination) != 0) return fail();
+
+    unlink(temporary_path);
+
+    return Ok();
+  }
+
+  if (rename(temporary_path, destination) != 0) return fail();
+
+  return Ok();
+}
+
+static Sys_Result<void> sync_directory (String directory) {
+  auto descriptor = open(Path_Buffer(directory), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (descriptor < 0) return get_system_error();
+  defer { close(descriptor); };
+
+  if (fsync(descriptor) != 0) return get_system_error();
+
+  return Ok();
+}
+
+/*
+  Files are processed in groups: all files of the group are written first, then flushed and renamed one by one,
+  by which time most of the writeback has been done. Directories of renamed files are collected across the whole
+  batch and each distinct one is flushed once at the end.
+ */
+static Sys_Result<void> write_files_atomically (Slice<Atomic_Write> files, Bit_Mask<Atomic_Write_Flags> flags) {
+  constexpr usize group_limit = 32;
+
+  // Anonymous files are linked through /proc, which might not be mounted.
+  const bool use_anonymous_files = access("/proc/self/fd", X_OK) == 0;
+
+  Staged_File staged[group_limit];
+
+  /*
+    Open addressing set of the batch's directories, an empty string marks a free slot. Batches spanning more
+    directories than the limit flush the collected ones whenever the set fills up.
+   */
+  constexpr usize directories_limit = 64;
+  constexpr usize directories_table = 2 * directories_limit;
+
+  const bool sync_directories = flags & Atomic_Write_Flags::Sync_Directory;
+
+  String directories[directories_table];
+  usize  directories_count = 0;
+
+  const auto flush_directories = [&] () -> Sys_Result<void> {
+    for (auto &directory: directories) {
+      if (is_empty(directory)) continue;
+
+      fin_check(sync_directory(directory));
+      directory = String();
+    }
+
+    directories_count = 0;
+
+    return Ok();
+  };
+
+  const auto collect_directory = [&] (String directory) -> Sys_Result<void> {
+    u64 hash = 0xcbf29ce484222325ull;
+    for (auto symbol: directory) {
+      hash ^= static_cast<u8>(symbol);
+      hash *= 0x100000001b3ull;
+    }
+
+    auto index = static_cast<usize>(hash) & (directories_table - 1);
+    for (; !is_empty(directories[index]); index = (index + 1) & (directories_table - 1)) {
+      if (directories[index] == directory) return Ok();
+    }
+
+    directories[index]  = directory;
+    directories_count  += 1;
+
+    if (directories_count == directories_limit) fin_check(flush_directories());
+
+    return Ok();
+  };
+
+  for (usize offset = 0; offset < files.count; offset += group_limit) {
+    auto count = (files.count - offset) < group_limit ? (files.count - offset) : group_limit;
+
+    for (usize idx = 0; idx < count; idx++) {
+      auto result = stage_atomic_write(staged[idx], files[offset + idx], flags, use_anonymous_files);
+      if (result.is_error()) {
+        for (usize discard = 0; discard < idx; discard++) discard_staged_file(staged[discard], files[offset + discard].path);
+
+        /*
+          Files renamed so far stay in place, their directories are still flushed on a best effort basis, while
+          the original failure is the one reported.
+         */
+        if (sync_directories) flush_directories();
+
+        return result;
+      }
+    }
+
+    for (usize idx = 0; idx < count; idx++) {
+      auto &path = files[offset + idx].path;
+
+      auto result = commit_atomic_write(staged[idx], path, flags);
+      if (result.is_error()) {
+        for (usize discard = idx + 1; discard < count; discard++) discard_staged_file(staged[discard], files[offset + discard].path);
+
+        if (sync_directories) flush_directories();
+
+        return result;
+      }
+
+      if (sync_directories) fin_check(collect_directory(get_parent_directory(path)));
+    }
+  }
+
+  if (sync_directories) fin_check(flush_directories());
+
+  return Ok();
+}
+
+static Sys_Result<Array<u8>> get_file_content (Memory_Arena &arena, File &file) {
+  fin_check(reset_file_cursor(file));
+
+  auto [sys_error, file_size] = get_file_size(file);
+  if (sys_error)  return move(sys_error.value);
+  if (!file_size) return Ok(Array<u8> {});
+
+  auto buffer = reserve_array<u8>(arena, file_size, alignof(u8));
+
+  fin_check(read_bytes_into_buffer(file, buffer.values, file_size));
+
+  return buffer;
+}
+
+static Sys_Result<void> reset_file_cursor (File &file) {
+  if (lseek(get_file_descriptor(file), 0, SEEK_SET) < 0) return get_system_error();
+
+  file.stream_cursor = 0;
+
+  return Ok();
+}
+
+static Sys_Result<u64> get_last_update_timestamp (const File &file) {
+  struct stat info;
+  if (fstat(get_file_descriptor(file), &info) != 0) return get_system_error();
+
+  return static_cast<u64>(info.st_mtim.tv_sec) * 1'000'000'000ull + static_cast<u64>(info.st_mtim.tv_nsec);
+}
+
+static Sys_Result<File_Mapping> map_file_into_memory (const File &file) {
+  auto [sys_error, mapping_size] = get_file_size(file);
+  if (sys_error) return move(sys_error.value);
+  if (mapping_size == 0) return File_Mapping {};
+
+  auto memory = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, get_file_descriptor(file), 0);
+  if (memory == MAP_FAILED) return get_system_error();
+
+  return File_Mapping {
+    .handle = memory,
+    .memory = reinterpret_cast<char *>(memory),
+    .size   = mapping_size
+  };
+}
+
+static Sys_Result<void> unmap_file (File_Mapping &mapping) {
+  // Empty files are not mapped, same as on Windows.
+  if (!mapping.handle) return Ok();
+
+  if (munmap(mapping.memory, mapping.size) != 0) return get_system_error();
+
+  return Ok();
+}
+
+}
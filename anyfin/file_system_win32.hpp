@@ -2,6 +2,7 @@
 #define FIN_FILE_SYSTEM_HPP_IMPL
 
 #include "anyfin/arena.hpp"
+#include "anyfin/atomics.hpp"
 #include "anyfin/option.hpp"
 #include "anyfin/strings.hpp"
 #include "anyfin/meta.hpp"
@@ -300,6 +301,106 @@ static Sys_Result<List<File_Path>> list_files (Memory_Arena &arena, File_Path di
   return Ok(move(file_list));
 }
 
+static Sys_Result<Array<File_Entry>> list_files_with_metadata (Memory_Arena &arena, File_Path directory) {
+  List<File_Entry> entries { arena };
+
+  auto list_recursive = [&] (this auto self, File_Path directory) -> Sys_Result<void> {
+    WIN32_FIND_DATAA data;
+
+    char buffer[2048];
+    Memory_Arena local { buffer };
+
+    auto search_handle = FindFirstFile(concat_string(local, directory, "\\*"), &data);
+    if (search_handle == INVALID_HANDLE_VALUE) return get_system_error();
+    defer { FindClose(search_handle); };
+
+    do {
+      const auto file_name = String(cast_bytes(data.cFileName));
+      if (file_name == "." || file_name == "..") continue;
+
+      auto file_path = make_file_path(arena, directory, file_name);
+
+      if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        fin_check(self(file_path));
+        continue;
+      }
+
+      ULARGE_INTEGER size, last_update;
+      size.HighPart        = data.nFileSizeHigh;
+      size.LowPart         = data.nFileSizeLow;
+      last_update.HighPart = data.ftLastWriteTime.dwHighDateTime;
+      last_update.LowPart  = data.ftLastWriteTime.dwLowDateTime;
+
+      list_push(entries, File_Entry {
+        .path     = file_path,
+        .metadata = File_Metadata {
+          .id          = 0,
+          .size        = static_cast<u64>(size.QuadPart),
+          .last_update = static_cast<u64>(last_update.QuadPart),
+          .type        = Resource_Type::File,
+        },
+      });
+    } while (FindNextFileA(search_handle, &data) != 0);
+
+    return Ok();
+  };
+
+  fin_check(list_recursive(directory));
+
+  auto result = reserve_array<File_Entry>(arena, entries.count);
+
+  usize index = 0;
+  for (auto &entry: entries) result[index++] = entry;
+
+  return result;
+}
+
+static Sys_Result<Array<File_Status>> query_metadata (Memory_Arena &arena, Slice<File_Path> paths) {
+  auto results = reserve_array<File_Status>(arena, paths.count);
+  if (paths.count && !results.values) return System_Error { "not enough memory in the arena for the query results", ERROR_NOT_ENOUGH_MEMORY };
+
+  for (usize idx = 0; idx < paths.count; idx++) {
+    char buffer[MAX_PATH];
+    Memory_Arena local { buffer };
+
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesEx(copy_string(local, paths[idx]), GetFileExInfoStandard, &data)) {
+      auto error_code = GetLastError();
+      if (error_code == ERROR_FILE_NOT_FOUND || error_code == ERROR_PATH_NOT_FOUND) {
+        results[idx] = File_Status { .exists = false };
+        continue;
+      }
+
+      results[idx] = File_Status { .exists = false, .error_code = static_cast<u32>(error_code) };
+      continue;
+    }
+
+    ULARGE_INTEGER size, last_update;
+    size.HighPart        = data.nFileSizeHigh;
+    size.LowPart         = data.nFileSizeLow;
+    last_update.HighPart = data.ftLastWriteTime.dwHighDateTime;
+    last_update.LowPart  = data.ftLastWriteTime.dwLowDateTime;
+
+    // File ids are only available through an opened handle.
+    results[idx] = File_Status {
+      .exists   = true,
+      .metadata = File_Metadata {
+        .id          = 0,
+        .size        = static_cast<u64>(size.QuadPart),
+        .last_update = static_cast<u64>(last_update.QuadPart),
+        .type        = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? Resource_Type::Directory : Resource_Type::File,
+      },
+    };
+  }
+
+  return results;
+}
+
+static Sys_Result<void> copy_file (File_Path from, File_Path to) {
+  if (!CopyFile(from.value, to.value, FALSE)) return get_system_error();
+  return Ok();
+}
+
 static Sys_Result<void> copy_directory (File_Path from, File_Path to) {
   auto copy_recursive = [] (this auto self, File_Path from, File_Path to) -> Sys_Result<void> {
     char buffer[2048];
@@ -325,7 +426,7 @@ static Sys_Result<void> copy_directory (File_Path from, File_Path to) {
           fin_check(self(file_to_move, destination));
         }
         else {
-          if (!CopyFile(file_to_move.value, destination.value, FALSE)) return get_system_error();
+          fin_check(copy_file(file_to_move, destination));
         }
       }
 
@@ -353,11 +454,15 @@ static Sys_Result<File> open_file (File_Path path, Bit_Mask<File_System_Flags> f
   auto creation = OPEN_EXISTING;
   if      (flags & Create_Missing) creation = OPEN_ALWAYS;
   else if (flags & Always_New)     creation = CREATE_ALWAYS;
+
+  DWORD attributes = FILE_ATTRIBUTE_NORMAL;
+  if (flags & Direct_IO) attributes |= FILE_FLAG_NO_BUFFERING;
+  if (flags & Streaming) attributes |= FILE_FLAG_SEQUENTIAL_SCAN;
   
-  auto handle = CreateFile(path.value, access, sharing, NULL, creation, FILE_ATTRIBUTE_NORMAL, NULL);
+  auto handle = CreateFile(path.value, access, sharing, NULL, creation, attributes, NULL);
   if (handle == INVALID_HANDLE_VALUE) return get_system_error();
 
-  return File { handle, move(path) };
+  return File { handle, move(path), flags };
 }
 
 static Sys_Result<void> close_file (File &file) {
@@ -384,7 +489,36 @@ static Sys_Result<u64> get_file_id (const File &file) {
   return file_id;
 }
 
+static usize get_direct_io_alignment () {
+  /*
+    Unbuffered I/O requires the alignment by the volume's sector size, which never exceeds the page size.
+   */
+  SYSTEM_INFO system_info;
+  GetSystemInfo(&system_info);
+
+  return system_info.dwPageSize;
+}
+
+static Sys_Result<void> check_direct_io_transfer (const File &file, const void *buffer, usize count, u64 offset = 0) {
+  if (!(file.flags & File_System_Flags::Direct_IO)) return Ok();
+
+  if (!is_aligned_for_direct_io(buffer, count, offset))
+    return System_Error { "Direct_IO buffer address, transfer size and file offset must be aligned by get_direct_io_alignment()", ERROR_INVALID_PARAMETER };
+
+  return Ok();
+}
+
+/*
+  Windows doesn't provide a way to release cached pages of a particular file range. Files opened in the
+  Streaming mode use FILE_FLAG_SEQUENTIAL_SCAN instead, which makes the cache manager drop the pages early.
+ */
+static Sys_Result<void> drop_file_cache (const File &file, u64 offset, u64 length) {
+  return Ok();
+}
+
 static Sys_Result<void> write_bytes_to_file (File &file, Byte_Type auto *bytes, usize count) {
+  fin_check(check_direct_io_transfer(file, bytes, count));
+
   DWORD total_bytes_written = 0;
   while (total_bytes_written < count) {
     DWORD bytes_written = 0;
@@ -404,10 +538,25 @@ static Sys_Result<void> write_bytes_to_file (File &file, Byte_Type auto *bytes,
   return Ok();
 }
 
+/*
+  WriteFileGather works only for unbuffered handles with page-aligned, page-sized segments, which doesn't fit
+  arbitrary strings, thus each section is written with its own call.
+ */
+static Sys_Result<void> write_gathered_to_file (File &file, Slice<String> sections) {
+  for (auto &section: sections) {
+    if (is_empty(section)) continue;
+    fin_check(write_bytes_to_file(file, section.value, section.length));
+  }
+
+  return Ok();
+}
+
 static Sys_Result<void> read_bytes_into_buffer (File &file, u8 *buffer, usize bytes_to_read) {
   fin_ensure(buffer);
   fin_ensure(bytes_to_read > 0);
 
+  fin_check(check_direct_io_transfer(file, buffer, bytes_to_read));
+
   usize offset = 0;
   while (offset < bytes_to_read) {
     DWORD bytes_read = 0;
@@ -421,6 +570,159 @@ static Sys_Result<void> read_bytes_into_buffer (File &file, u8 *buffer, usize by
   return Ok();
 }
 
+/*
+  For handles opened for synchronous I/O, ReadFile and WriteFile with the offset in OVERLAPPED are positional.
+  They also move the file's cursor, which doesn't affect other positional calls, but mixing them with
+  cursor-based calls on the same handle is not safe.
+ */
+static OVERLAPPED make_positional_overlapped (u64 offset) {
+  OVERLAPPED overlapped {};
+  overlapped.Offset     = static_cast<DWORD>(offset);
+  overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+  return overlapped;
+}
+
+static Sys_Result<usize> read_bytes_at (const File &file, u64 offset, u8 *buffer, usize bytes_to_read) {
+  fin_ensure(buffer);
+  fin_check(check_direct_io_transfer(file, buffer, bytes_to_read, offset));
+
+  usize total_bytes_read = 0;
+  while (total_bytes_read < bytes_to_read) {
+    auto remaining   = bytes_to_read - total_bytes_read;
+    auto chunk_size  = static_cast<DWORD>(remaining > 0x7fffffff ? 0x7fffffff : remaining);
+    auto overlapped  = make_positional_overlapped(offset + total_bytes_read);
+
+    DWORD bytes_read = 0;
+    if (!ReadFile(file.handle, buffer + total_bytes_read, chunk_size, &bytes_read, &overlapped)) {
+      if (get_system_error_code() == ERROR_HANDLE_EOF) break;
+      return get_system_error();
+    }
+
+    if (bytes_read == 0) break;
+
+    total_bytes_read += bytes_read;
+  }
+
+  return total_bytes_read;
+}
+
+static Sys_Result<usize> read_bytes_at (const File &file, u64 offset, Slice<Array<u8>> buffers) {
+  usize total_bytes_read = 0;
+  for (auto &buffer: buffers) {
+    if (is_empty(buffer)) continue;
+
+    auto [error, bytes_read] = read_bytes_at(file, offset + total_bytes_read, buffer.values, buffer.count);
+    if (error) return move(error.value);
+
+    total_bytes_read += bytes_read;
+    if (bytes_read < buffer.count) break;
+  }
+
+  return total_bytes_read;
+}
+
+static Sys_Result<void> write_bytes_at (const File &file, u64 offset, const u8 *bytes, usize count) {
+  fin_check(check_direct_io_transfer(file, bytes, count, offset));
+
+  usize total_bytes_written = 0;
+  while (total_bytes_written < count) {
+    auto remaining  = count - total_bytes_written;
+    auto chunk_size = static_cast<DWORD>(remaining > 0x7fffffff ? 0x7fffffff : remaining);
+    auto overlapped = make_positional_overlapped(offset + total_bytes_written);
+
+    DWORD bytes_written = 0;
+    if (!WriteFile(file.handle, bytes + total_bytes_written, chunk_size, &bytes_written, &overlapped))
+      return get_system_error();
+
+    if (bytes_written == 0) return get_system_error();
+
+    total_bytes_written += bytes_written;
+  }
+
+  return Ok();
+}
+
+static Sys_Result<void> write_bytes_at (const File &file, u64 offset, Slice<String> sections) {
+  for (auto &section: sections) {
+    if (is_empty(section)) continue;
+
+    fin_check(write_bytes_at(file, offset, cast_bytes<u8>(section.value), section.length));
+    offset += section.length;
+  }
+
+  return Ok();
+}
+
+static Sys_Result<usize> read_available_bytes (File &file, u8 *buffer, usize buffer_size) {
+  fin_ensure(buffer);
+
+  DWORD bytes_read = 0;
+  if (!ReadFile(file.handle, buffer, buffer_size, &bytes_read, nullptr)) {
+    // The writing end of a pipe has been closed, which is the end of the stream.
+    if (get_system_error_code() == ERROR_BROKEN_PIPE) return 0;
+    return get_system_error();
+  }
+
+  return static_cast<usize>(bytes_read);
+}
+
+static File get_standard_input () {
+  return File { GetStdHandle(STD_INPUT_HANDLE), "stdin" };
+}
+
+static File get_standard_output () {
+  return File { GetStdHandle(STD_OUTPUT_HANDLE), "stdout" };
+}
+
+/*
+  Windows has no way to flush a directory, MOVEFILE_WRITE_THROUGH makes the rename durable on its own instead,
+  thus files are simply processed one by one.
+ */
+static Sys_Result<void> write_files_atomically (Slice<Atomic_Write> files, Bit_Mask<Atomic_Write_Flags> flags) {
+  using enum Atomic_Write_Flags;
+
+  static au32 counter;
+
+  for (auto &write: files) {
+    char buffer[2 * MAX_PATH];
+    Memory_Arena local { buffer };
+
+    auto temporary_path = concat_string(local, write.path, ".", GetCurrentProcessId(), ".", atomic_fetch_add(counter, 1), ".tmp");
+
+    auto handle = CreateFile(temporary_path.value, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_TEMPORARY, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return get_system_error();
+
+    auto file = File { handle, temporary_path };
+
+    const auto fail = [&] () -> System_Error {
+      auto error = get_system_error();
+
+      if (file.handle) CloseHandle(file.handle);
+      DeleteFile(temporary_path.value);
+
+      return error;
+    };
+
+    if (write_gathered_to_file(file, write.sections).is_error()) return fail();
+
+    if ((flags & Sync_Data) || (flags & Sync_Metadata)) {
+      if (!FlushFileBuffers(file.handle)) return fail();
+    }
+
+    CloseHandle(file.handle);
+    file.handle = nullptr;
+
+    DWORD move_flags = 0;
+    if (!(flags & No_Replace))      move_flags |= MOVEFILE_REPLACE_EXISTING;
+    if (flags & Sync_Directory)     move_flags |= MOVEFILE_WRITE_THROUGH;
+
+    if (!MoveFileEx(temporary_path.value, write.path.value, move_flags)) return fail();
+  }
+
+  return Ok();
+}
+
 static Sys_Result<Array<u8>> get_file_content (Memory_Arena &arena, File &file) {
   fin_check(reset_file_cursor(file));
 
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/arena.hpp"
+#include "anyfin/bit_mask.hpp"
+#include "anyfin/file_system.hpp"
+#include "anyfin/list.hpp"
+#include "anyfin/platform.hpp"
+
+namespace Fin {
+
+enum struct File_Change_Kind: u32 {
+  Created  = fin_flag(0),
+  Modified = fin_flag(1),
+  Deleted  = fin_flag(2),
+
+  /*
+    The system's event queue has overflown and some changes were lost. The path is empty in this case, callers
+    should fall back to rescanning the watched directories.
+   */
+  Overflow = fin_flag(3),
+};
+
+/*
+  All events related to the same path within one batch are merged into a single change, thus a file that was
+  created and then modified is reported once with both kinds set.
+ */
+struct File_Change {
+  File_Path path;
+  Bit_Mask<File_Change_Kind> kinds;
+};
+
+struct File_Watcher {
+  struct Handle;
+  Handle *handle;
+};
+
+/*
+  The arena keeps the watcher's state and the paths of watched directories, thus it must outlive the watcher.
+  `watches_limit` is the maximum number of directories that could be watched at the same time.
+ */
+static Sys_Result<File_Watcher> create_file_watcher (Memory_Arena &arena, usize watches_limit = 65536);
+
+static Sys_Result<void> destroy (File_Watcher &watcher);
+
+/*
+  Start watching the directory for changes of its content. With `recursive` set, all subdirectories are
+  watched as well, including those that would be created later.
+ */
+static Sys_Result<void> watch_directory (File_Watcher &watcher, File_Path directory, bool recursive = true);
+
+/*
+  Block for up to `timeout_millis` (negative value waits indefinitely) until some changes are detected. Once the
+  first event has arrived, events are collected until no new events arrive for `coalesce_millis`, so that bursts
+  (e.g a checkout touching thousands of files) are delivered as a single batch. Changes are placed in the arena.
+ */
+static Sys_Result<List<File_Change>> wait_for_changes (File_Watcher &watcher, Memory_Arena &arena, s32 timeout_millis = -1, u32 coalesce_millis = 50);
+
+}
+
+#ifndef FIN_FILE_WATCHER_HPP_IMPL
+  #ifdef PLATFORM_LINUX
+    #include "anyfin/file_watcher_linux.hpp"
+  #else
+    #error "Unsupported platform"
+  #endif
+#endif
@@ -0,0 +1,356 @@
+
+#define FIN_FILE_WATCHER_HPP_IMPL
+
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "anyfin/defer.hpp"
+#include "anyfin/file_system.hpp"
+#include "anyfin/file_watcher.hpp"
+
+namespace Fin {
+
+struct File_Watcher::Handle {
+  struct Watch {
+    s32       watch_id; // Zero marks a free slot, inotify's ids start from 1
+    File_Path path;
+    bool      recursive;
+  };
+
+  Memory_Arena *arena;
+  int           descriptor;
+
+  /*
+    inotify hands out watch descriptors as increasing numbers that are never reused, thus a long-running watcher
+    sees ids far beyond the number of live watches. Watches are kept in an open addressing table keyed by the id,
+    which is at least twice as large as the limit, so that probe sequences stay short.
+   */
+  Watch *watches;
+  usize  table_size; // Power of two
+  usize  watches_count;
+  usize  watches_limit;
+};
+
+static usize get_watch_slot (const File_Watcher::Handle &watcher, s32 watch_id) {
+  // Ids are sequential, multiplying by an odd constant scatters them across the table.
+  return static_cast<usize>(static_cast<u32>(watch_id) * 0x9E3779B1u) & (watcher.table_size - 1);
+}
+
+static File_Watcher::Handle::Watch * find_watch (File_Watcher::Handle &watcher, s32 watch_id) {
+  for (auto index = get_watch_slot(watcher, watch_id); watcher.watches[index].watch_id; index = (index + 1) & (watcher.table_size - 1)) {
+    if (watcher.watches[index].watch_id == watch_id) return &watcher.watches[index];
+  }
+
+  return nullptr;
+}
+
+/*
+  Entries following the removed one are shifted back into the hole when their probe sequence passes through it,
+  thus lookups never need tombstones, no matter how many watches come and go.
+ */
+static void remove_watch (File_Watcher::Handle &watcher, File_Watcher::Handle::Watch &watch) {
+  const auto mask = watcher.table_size - 1;
+
+  auto hole = static_cast<usize>(&watch - watcher.watches);
+  for (auto index = (hole + 1) & mask; watcher.watches[index].watch_id; index = (index + 1) & mask) {
+    auto home = get_watch_slot(watcher, watcher.watches[index].watch_id);
+    if (((index - home) & mask) < ((index - hole) & mask)) continue;
+
+    watcher.watches[hole] = watcher.watches[index];
+    hole = index;
+  }
+
+  watcher.watches[hole].watch_id = 0;
+  watcher.watches_count -= 1;
+}
+
+constexpr u32 watcher_event_mask =
+  IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+  IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+static Sys_Result<File_Watcher> create_file_watcher (Memory_Arena &arena, usize watches_limit) {
+  auto handle = reserve<File_Watcher::Handle>(arena);
+  if (!handle) return System_Error { "not enough memory in the arena for the file watcher", ENOMEM };
+
+  usize table_size = 1;
+  while (table_size < 2 * watches_limit) table_size <<= 1;
+
+  auto watches = reserve<File_Watcher::Handle::Watch>(arena, sizeof(File_Watcher::Handle::Watch) * table_size);
+  if (!watches) return System_Error { "not enough memory in the arena for the watches table", ENOMEM };
+
+  zero_memory(watches, table_size);
+
+  // These are enumerators in glibc, which would otherwise pick up Bit_Mask's operator.
+  auto descriptor = inotify_init1(static_cast<int>(IN_NONBLOCK) | static_cast<int>(IN_CLOEXEC));
+  if (descriptor < 0) return get_system_error();
+
+  *handle = File_Watcher::Handle {
+    .arena         = &arena,
+    .descriptor    = descriptor,
+    .watches       = watches,
+    .table_size    = table_size,
+    .watches_count = 0,
+    .watches_limit = watches_limit,
+  };
+
+  return File_Watcher { handle };
+}
+
+static Sys_Result<void> destroy (File_Watcher &watcher) {
+  if (close(watcher.handle->descriptor) != 0) return get_system_error();
+  watcher.handle = nullptr;
+
+  return Ok();
+}
+
+static Sys_Result<s32> add_directory_watch (File_Watcher::Handle &watcher, File_Path directory, bool recursive) {
+  auto watch_id = inotify_add_watch(watcher.descriptor, Path_Buffer(directory), watcher_event_mask | IN_ONLYDIR);
+  if (watch_id < 0) return get_system_error();
+
+  // The same directory may be registered again (e.g moved back), keeping the original path in that case.
+  if (find_watch(watcher, watch_id)) return watch_id;
+
+  if (watcher.watches_count == watcher.watches_limit) {
+    inotify_rm_watch(watcher.descriptor, watch_id);
+    return System_Error { "file watcher's watches limit has been reached", ENOSPC };
+  }
+
+  auto path = copy_string(*watcher.arena, directory);
+  if (!path.value) {
+    inotify_rm_watch(watcher.descriptor, watch_id);
+    return System_Error { "not enough memory in the arena for the watched path", ENOMEM };
+  }
+
+  auto index = get_watch_slot(watcher, watch_id);
+  while (watcher.watches[index].watch_id) index = (index + 1) & (watcher.table_size - 1);
+
+  watcher.watches[index] = File_Watcher::Handle::Watch {
+    .watch_id  = watch_id,
+    .path      = path,
+    .recursive = recursive,
+  };
+
+  watcher.watches_count += 1;
+
+  return watch_id;
+}
+
+/*
+  Registers watches for the directory and all its subdirectories. When `on_entry` is provided, it's called for
+  every entry found, which is used for directories created after the watch was set up: files could've been
+  created inside before the watch was registered and their events would be missed otherwise.
+
+  Directories that are gone by the time they are registered (e.g transient build directories) are skipped,
+  their removal is reported through the parent's events.
+ */
+static Sys_Result<void> add_recursive_watch (File_Watcher::Handle &watcher, File_Path directory, const auto &on_entry) {
+  auto [watch_error, watch_id] = add_directory_watch(watcher, directory, true);
+  if (watch_error) {
+    // ENOTDIR if a file has taken the directory's name in the meantime.
+    auto error_code = watch_error.value.error_code;
+    if (error_code == ENOENT || error_code == ENOTDIR) return Ok();
+
+    return move(watch_error.value);
+  }
+
+  auto handle = opendir(Path_Buffer(directory));
+  if (!handle) {
+    if (errno == ENOENT || errno == ENOTDIR) return Ok();
+    return get_system_error();
+  }
+  defer { closedir(handle); };
+
+  while (true) {
+    errno = 0;
+    auto entry = readdir(handle);
+    if (!entry) {
+      if (errno) return get_system_error();
+      break;
+    }
+
+    if (is_special_entry(entry)) continue;
+
+    auto name = String(cast_bytes(entry->d_name));
+    on_entry(watch_id, name);
+
+    if (!is_directory_entry(handle, entry)) continue;
+
+    if (directory.length + 1 + name.length >= PATH_MAX) return System_Error { "path is too long", ENAMETOOLONG };
+
+    char buffer[PATH_MAX + 1];
+    Memory_Arena local { buffer };
+
+    fin_check(add_recursive_watch(watcher, make_file_path(local, directory, name), on_entry));
+  }
+
+  return Ok();
+}
+
+static Sys_Result<void> watch_directory (File_Watcher &watcher, File_Path directory, bool recursive) {
+  // Unlike subdirectories found along the way, the requested directory must exist, thus it's registered upfront.
+  auto [error, watch_id] = add_directory_watch(*watcher.handle, directory, recursive);
+  if (error) return move(error.value);
+
+  if (!recursive) return Ok();
+
+  return add_recursive_watch(*watcher.handle, directory, [] (s32, String) {});
+}
+
+/*
+  FNV-1a over the watch id and the entry's name, which identifies the path uniquely within the watcher.
+ */
+static u64 hash_watch_entry (s32 watch_id, String name) {
+  u64 hash = 0xcbf29ce484222325ull;
+
+  for (usize idx = 0; idx < sizeof(watch_id); idx++) {
+    hash ^= static_cast<u8>(watch_id >> (idx * 8));
+    hash *= 0x100000001b3ull;
+  }
+
+  for (auto symbol: name) {
+    hash ^= static_cast<u8>(symbol);
+    hash *= 0x100000001b3ull;
+  }
+
+  return hash;
+}
+
+static Sys_Result<List<File_Change>> wait_for_changes (File_Watcher &_watcher, Memory_Arena &arena, s32 timeout_millis, u32 coalesce_millis) {
+  auto &watcher = *_watcher.handle;
+
+  List<File_Change> changes { arena };
+
+  /*
+    Events of the batch are merged by their path in the table below. A single read returns at most
+    sizeof(buffer) / sizeof(inotify_event) events, coalescing stops before the table could get overfilled.
+   */
+  struct Pending_Change {
+    u64          hash;
+    s32          watch_id;
+    File_Path    directory; // The watch could be removed before the batch is complete
+    String       name;
+    File_Change *change;
+  };
+
+  constexpr usize events_buffer_size = kilobytes(64);
+  constexpr usize table_size         = 4 * (events_buffer_size / sizeof(inotify_event));
+  constexpr usize pending_limit      = table_size / 4;
+
+  auto table = reserve_array<Pending_Change>(arena, table_size);
+  if (!table.values) return System_Error { "not enough memory in the arena for the changes batch", ENOMEM };
+  zero_memory(table.values, table.count);
+
+  usize pending_count = 0;
+
+  const auto record_change = [&] (s32 watch_id, String name, File_Change_Kind kind) {
+    auto hash  = hash_watch_entry(watch_id, name);
+    auto index = hash & (table_size - 1);
+
+    while (table[index].change) {
+      auto &slot = table[index];
+      if (slot.hash == hash && slot.watch_id == watch_id && slot.name == name) {
+        slot.change->kinds = slot.change->kinds | kind;
+        return;
+      }
+
+      index = (index + 1) & (table_size - 1);
+    }
+
+    auto &change = list_push(changes, File_Change { .kinds = kind });
+    table[index] = Pending_Change { hash, watch_id, find_watch(watcher, watch_id)->path, copy_string(arena, name), &change };
+
+    pending_count += 1;
+  };
+
+  alignas(inotify_event) char buffer[events_buffer_size];
+
+  pollfd poll_request { .fd = watcher.descriptor, .events = POLLIN };
+
+  auto wait_time = timeout_millis;
+  while (pending_count < pending_limit) {
+    auto status = poll(&poll_request, 1, wait_time);
+    if (status < 0) {
+      if (errno == EINTR) continue;
+      return get_system_error();
+    }
+
+    if (status == 0) break;
+
+    auto bytes_read = read(watcher.descriptor, buffer, sizeof(buffer));
+    if (bytes_read < 0) {
+      if (errno == EAGAIN || errno == EINTR) continue;
+      return get_system_error();
+    }
+
+    for (auto cursor = buffer; cursor < buffer + bytes_read;) {
+      auto event = reinterpret_cast<const inotify_event *>(cursor);
+      cursor += sizeof(inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        list_push(changes, File_Change { .kinds = File_Change_Kind::Overflow });
+        continue;
+      }
+
+      auto watch_id = event->wd;
+
+      auto watch = find_watch(watcher, watch_id);
+      if (!watch) continue;
+
+      if (event->mask & IN_IGNORED) {
+        remove_watch(watcher, *watch);
+        continue;
+      }
+
+      // New watches may be added below, the slot's content is copied out beforehand.
+      auto directory = watch->path;
+      auto recursive = watch->recursive;
+
+      auto name = event->len ? String(cast_bytes(event->name)) : String();
+
+      if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        record_change(watch_id, {}, File_Change_Kind::Deleted);
+        continue;
+      }
+
+      if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+        record_change(watch_id, name, File_Change_Kind::Created);
+
+        if ((event->mask & IN_ISDIR) && recursive) {
+          if (directory.length + 1 + name.length >= PATH_MAX) return System_Error { "path is too long", ENAMETOOLONG };
+
+          char path_buffer[PATH_MAX + 1];
+          Memory_Arena local { path_buffer };
+
+          auto on_entry = [&] (s32 parent_id, String entry_name) {
+            if (pending_count < pending_limit) record_change(parent_id, entry_name, File_Change_Kind::Created);
+          };
+
+          fin_check(add_recursive_watch(watcher, make_file_path(local, directory, name), on_entry));
+        }
+      }
+
+      if (event->mask & (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB))
+        record_change(watch_id, name, File_Change_Kind::Modified);
+
+      if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+        record_change(watch_id, name, File_Change_Kind::Deleted);
+    }
+
+    wait_time = coalesce_millis;
+  }
+
+  /*
+    Paths are rendered once the batch is complete, so that the arena holds a single copy per changed path.
+   */
+  for (auto &slot: table) {
+    if (!slot.change) continue;
+
+    slot.change->path = is_empty(slot.name) ? slot.directory : make_file_path(arena, slot.directory, slot.name);
+  }
+
+  return Ok(move(changes));
+}
+
+}
@@ -124,6 +124,9 @@ static void print_argument (Memory_Arena &arena, usize index, Format_String &for
       copy_memory(buffer, str.value, str.length);
     }
   }
+  else if constexpr (Integral<raw_type<T>>) {
+    write_integer(arena, arg);
+  }
   else {
     auto str = to_string(forward<T>(arg), arena);
     fin_ensure(!is_empty(str));
@@ -131,6 +134,7 @@ static void print_argument (Memory_Arena &arena, usize index, Format_String &for
     /*
       To main proper C strings interface with null terminators to_string would place a \0 after the renderered string.
       For the formatting purposes we don't need that and adjust the arena manually to "offset" the terminator.
+      Integers, the most common case by far, are rendered in place above and don't need this.
      */
     if (str.length) [[likely]] {
       fin_ensure(str.value[str.length] == '\0');
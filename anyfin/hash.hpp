@@ -0,0 +1,716 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/atomics.hpp"
+#include "anyfin/file_system.hpp"
+#include "anyfin/platform.hpp"
+#include "anyfin/strings.hpp"
+#include "anyfin/threads.hpp"
+
+#ifdef CPU_ARCH_X64
+  #include <immintrin.h>
+#endif
+
+namespace Fin {
+
+/*
+  Content hashing. hash_64 and hash_128 produce the same values as XXH3 (64 and 128 bit variants) and are meant
+  for hash tables and change detection, hash_blake3 is the BLAKE3 cryptographic hash for content addressing,
+  where collisions have to be ruled out.
+ */
+
+struct Hash_128 {
+  u64 low;
+  u64 high;
+
+  constexpr bool operator == (const Hash_128 &other) const = default;
+};
+
+struct Hash_256 {
+  u8 bytes[32];
+
+  constexpr bool operator == (const Hash_256 &other) const = default;
+};
+
+fin_forceinline static u32 xxh_read32 (const u8 *memory) { u32 value; __builtin_memcpy(&value, memory, sizeof(value)); return value; }
+fin_forceinline static u64 xxh_read64 (const u8 *memory) { u64 value; __builtin_memcpy(&value, memory, sizeof(value)); return value; }
+
+fin_forceinline static u32 xxh_rotl32 (u32 value, u32 shift) { return (value << shift) | (value >> (32 - shift)); }
+fin_forceinline static u64 xxh_rotl64 (u64 value, u32 shift) { return (value << shift) | (value >> (64 - shift)); }
+
+constexpr u32 xxh_prime32_1 = 0x9E3779B1u;
+constexpr u32 xxh_prime32_2 = 0x85EBCA77u;
+constexpr u32 xxh_prime32_3 = 0xC2B2AE3Du;
+
+constexpr u64 xxh_prime64_1 = 0x9E3779B185EBCA87ull;
+constexpr u64 xxh_prime64_2 = 0xC2B2AE3D27D4EB4Full;
+constexpr u64 xxh_prime64_3 = 0x165667B19E3779F9ull;
+constexpr u64 xxh_prime64_4 = 0x85EBCA77C2B2AE63ull;
+constexpr u64 xxh_prime64_5 = 0x27D4EB2F165667C5ull;
+
+constexpr u64 xxh_prime_mx1 = 0x165667919E3779F9ull;
+constexpr u64 xxh_prime_mx2 = 0x9FB21C651E98DF25ull;
+
+constexpr usize xxh3_secret_size    = 192;
+constexpr usize xxh3_stripe_length  = 64;
+constexpr usize xxh3_secret_advance = 8;
+constexpr usize xxh3_stripes_count  = (xxh3_secret_size - xxh3_stripe_length) / xxh3_secret_advance;
+constexpr usize xxh3_block_length   = xxh3_stripe_length * xxh3_stripes_count;
+
+alignas(64) constexpr u8 xxh3_default_secret[xxh3_secret_size] {
+  0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+  0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+  0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+  0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+  0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+  0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+  0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+  0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+  0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+  0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+  0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+  0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+fin_forceinline
+static Hash_128 xxh_multiply_128 (u64 left, u64 right) {
+  auto product = static_cast<unsigned __int128>(left) * right;
+  return Hash_128 { static_cast<u64>(product), static_cast<u64>(product >> 64) };
+}
+
+fin_forceinline
+static u64 xxh_multiply_fold64 (u64 left, u64 right) {
+  auto product = xxh_multiply_128(left, right);
+  return product.low ^ product.high;
+}
+
+static u64 xxh64_avalanche (u64 hash) {
+  hash ^= hash >> 33;
+  hash *= xxh_prime64_2;
+  hash ^= hash >> 29;
+  hash *= xxh_prime64_3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+static u64 xxh3_avalanche (u64 hash) {
+  hash ^= hash >> 37;
+  hash *= xxh_prime_mx1;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+static u64 xxh3_rrmxmx (u64 hash, u64 length) {
+  hash ^= xxh_rotl64(hash, 49) ^ xxh_rotl64(hash, 24);
+  hash *= xxh_prime_mx2;
+  hash ^= (hash >> 35) + length;
+  hash *= xxh_prime_mx2;
+  return hash ^ (hash >> 28);
+}
+
+fin_forceinline
+static u64 xxh3_mix16 (const u8 *input, const u8 *secret, u64 seed) {
+  return xxh_multiply_fold64(xxh_read64(input)     ^ (xxh_read64(secret)     + seed),
+                             xxh_read64(input + 8) ^ (xxh_read64(secret + 8) - seed));
+}
+
+/*
+  Long inputs are consumed in 64 byte stripes by eight 64-bit lanes, which is where the vector paths apply.
+ */
+fin_forceinline
+static void xxh3_accumulate_stripe (u64 *accumulators, const u8 *input, const u8 *secret) {
+#if defined(__AVX2__)
+  auto acc = reinterpret_cast<__m256i *>(accumulators);
+
+  for (usize idx = 0; idx < 2; idx++) {
+    auto data     = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input)  + idx);
+    auto key      = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(secret) + idx);
+    auto data_key = _mm256_xor_si256(data, key);
+    auto product  = _mm256_mul_epu32(data_key, _mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1)));
+    auto swapped  = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+
+    _mm256_store_si256(acc + idx, _mm256_add_epi64(product, _mm256_add_epi64(_mm256_load_si256(acc + idx), swapped)));
+  }
+#elif defined(CPU_ARCH_X64)
+  auto acc = reinterpret_cast<__m128i *>(accumulators);
+
+  for (usize idx = 0; idx < 4; idx++) {
+    auto data     = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input)  + idx);
+    auto key      = _mm_loadu_si128(reinterpret_cast<const __m128i *>(secret) + idx);
+    auto data_key = _mm_xor_si128(data, key);
+    auto product  = _mm_mul_epu32(data_key, _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1)));
+    auto swapped  = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+
+    _mm_store_si128(acc + idx, _mm_add_epi64(product, _mm_add_epi64(_mm_load_si128(acc + idx), swapped)));
+  }
+#else
+  for (usize idx = 0; idx < 8; idx++) {
+    auto data     = xxh_read64(input + 8 * idx);
+    auto data_key = data ^ xxh_read64(secret + 8 * idx);
+
+    accumulators[idx ^ 1] += data;
+    accumulators[idx]     += static_cast<u64>(static_cast<u32>(data_key)) * (data_key >> 32);
+  }
+#endif
+}
+
+fin_forceinline
+static void xxh3_scramble (u64 *accumulators, const u8 *secret) {
+#if defined(__AVX2__)
+  auto acc   = reinterpret_cast<__m256i *>(accumulators);
+  auto prime = _mm256_set1_epi32(static_cast<s32>(xxh_prime32_1));
+
+  for (usize idx = 0; idx < 2; idx++) {
+    auto value    = _mm256_load_si256(acc + idx);
+    auto key      = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(secret) + idx);
+    auto data_key = _mm256_xor_si256(_mm256_xor_si256(value, _mm256_srli_epi64(value, 47)), key);
+    auto low      = _mm256_mul_epu32(data_key, prime);
+    auto high     = _mm256_mul_epu32(_mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+
+    _mm256_store_si256(acc + idx, _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+  }
+#elif defined(CPU_ARCH_X64)
+  auto acc   = reinterpret_cast<__m128i *>(accumulators);
+  auto prime = _mm_set1_epi32(static_cast<s32>(xxh_prime32_1));
+
+  for (usize idx = 0; idx < 4; idx++) {
+    auto value    = _mm_load_si128(acc + idx);
+    auto key      = _mm_loadu_si128(reinterpret_cast<const __m128i *>(secret) + idx);
+    auto data_key = _mm_xor_si128(_mm_xor_si128(value, _mm_srli_epi64(value, 47)), key);
+    auto low      = _mm_mul_epu32(data_key, prime);
+    auto high     = _mm_mul_epu32(_mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+
+    _mm_store_si128(acc + idx, _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+  }
+#else
+  for (usize idx = 0; idx < 8; idx++) {
+    auto value = accumulators[idx];
+    value ^= value >> 47;
+    value ^= xxh_read64(secret + 8 * idx);
+    accumulators[idx] = value * xxh_prime32_1;
+  }
+#endif
+}
+
+static void xxh3_hash_long (u64 *accumulators, const u8 *input, usize length, const u8 *secret) {
+  const auto blocks_count = (length - 1) / xxh3_block_length;
+
+  for (usize block = 0; block < blocks_count; block++) {
+    auto block_input = input + block * xxh3_block_length;
+
+    for (usize stripe = 0; stripe < xxh3_stripes_count; stripe++)
+      xxh3_accumulate_stripe(accumulators, block_input + stripe * xxh3_stripe_length, secret + stripe * xxh3_secret_advance);
+
+    xxh3_scramble(accumulators, secret + xxh3_secret_size - xxh3_stripe_length);
+  }
+
+  auto tail_input    = input + blocks_count * xxh3_block_length;
+  auto stripes_count = ((length - 1) - blocks_count * xxh3_block_length) / xxh3_stripe_length;
+
+  for (usize stripe = 0; stripe < stripes_count; stripe++)
+    xxh3_accumulate_stripe(accumulators, tail_input + stripe * xxh3_stripe_length, secret + stripe * xxh3_secret_advance);
+
+  xxh3_accumulate_stripe(accumulators, input + length - xxh3_stripe_length, secret + xxh3_secret_size - xxh3_stripe_length - 7);
+}
+
+static u64 xxh3_merge_accumulators (const u64 *accumulators, const u8 *secret, u64 start) {
+  auto result = start;
+
+  for (usize idx = 0; idx < 4; idx++) {
+    result += xxh_multiply_fold64(accumulators[2 * idx]     ^ xxh_read64(secret + 16 * idx),
+                                  accumulators[2 * idx + 1] ^ xxh_read64(secret + 16 * idx + 8));
+  }
+
+  return xxh3_avalanche(result);
+}
+
+/*
+  Seeded hashing of long inputs works with a secret derived from the seed, shorter inputs mix the seed in directly.
+ */
+static void xxh3_derive_secret (u8 *secret, u64 seed) {
+  for (usize idx = 0; idx < xxh3_secret_size / 16; idx++) {
+    auto low  = xxh_read64(xxh3_default_secret + 16 * idx)     + seed;
+    auto high = xxh_read64(xxh3_default_secret + 16 * idx + 8) - seed;
+
+    __builtin_memcpy(secret + 16 * idx,     &low,  sizeof(low));
+    __builtin_memcpy(secret + 16 * idx + 8, &high, sizeof(high));
+  }
+}
+
+#define XXH3_INITIAL_ACCUMULATORS                                       \
+  { xxh_prime32_3, xxh_prime64_1, xxh_prime64_2, xxh_prime64_3,         \
+    xxh_prime64_4, xxh_prime32_2, xxh_prime64_5, xxh_prime32_1 }
+
+static u64 hash_64 (const void *data, usize length, u64 seed = 0) {
+  auto input  = reinterpret_cast<const u8 *>(data);
+  auto secret = xxh3_default_secret;
+
+  if (length <= 16) {
+    if (length > 8) {
+      auto bitflip_low  = (xxh_read64(secret + 24) ^ xxh_read64(secret + 32)) + seed;
+      auto bitflip_high = (xxh_read64(secret + 40) ^ xxh_read64(secret + 48)) - seed;
+      auto input_low    = xxh_read64(input) ^ bitflip_low;
+      auto input_high   = xxh_read64(input + length - 8) ^ bitflip_high;
+
+      return xxh3_avalanche(length + __builtin_bswap64(input_low) + input_high + xxh_multiply_fold64(input_low, input_high));
+    }
+
+    if (length >= 4) {
+      seed ^= static_cast<u64>(__builtin_bswap32(static_cast<u32>(seed))) << 32;
+
+      auto bitflip = (xxh_read64(secret + 8) ^ xxh_read64(secret + 16)) - seed;
+      auto value   = xxh_read32(input + length - 4) + (static_cast<u64>(xxh_read32(input)) << 32);
+
+      return xxh3_rrmxmx(value ^ bitflip, length);
+    }
+
+    if (length > 0) {
+      u32 combined = (static_cast<u32>(input[0]) << 16) | (static_cast<u32>(input[length >> 1]) << 24) |
+                     static_cast<u32>(input[length - 1]) | (static_cast<u32>(length) << 8);
+      auto bitflip = static_cast<u64>(xxh_read32(secret) ^ xxh_read32(secret + 4)) + seed;
+
+      return xxh64_avalanche(static_cast<u64>(combined) ^ bitflip);
+    }
+
+    return xxh64_avalanche(seed ^ xxh_read64(secret + 56) ^ xxh_read64(secret + 64));
+  }
+
+  if (length <= 128) {
+    u64 accumulator = length * xxh_prime64_1;
+
+    if (length > 32) {
+      if (length > 64) {
+        if (length > 96) {
+          accumulator += xxh3_mix16(input + 48, secret + 96, seed);
+          accumulator += xxh3_mix16(input + length - 64, secret + 112, seed);
+        }
+        accumulator += xxh3_mix16(input + 32, secret + 64, seed);
+        accumulator += xxh3_mix16(input + length - 48, secret + 80, seed);
+      }
+      accumulator += xxh3_mix16(input + 16, secret + 32, seed);
+      accumulator += xxh3_mix16(input + length - 32, secret + 48, seed);
+    }
+    accumulator += xxh3_mix16(input, secret, seed);
+    accumulator += xxh3_mix16(input + length - 16, secret + 16, seed);
+
+    return xxh3_avalanche(accumulator);
+  }
+
+  if (length <= 240) {
+    u64 accumulator = length * xxh_prime64_1;
+    for (usize idx = 0; idx < 8; idx++) accumulator += xxh3_mix16(input + 16 * idx, secret + 16 * idx, seed);
+
+    auto tail = xxh3_mix16(input + length - 16, secret + 136 - 17, seed);
+    accumulator = xxh3_avalanche(accumulator);
+
+    for (usize idx = 8; idx < length / 16; idx++) tail += xxh3_mix16(input + 16 * idx, secret + 16 * (idx - 8) + 3, seed);
+
+    return xxh3_avalanche(accumulator + tail);
+  }
+
+  alignas(64) u8 derived_secret[xxh3_secret_size];
+  if (seed) {
+    xxh3_derive_secret(derived_secret, seed);
+    secret = derived_secret;
+  }
+
+  alignas(64) u64 accumulators[8] XXH3_INITIAL_ACCUMULATORS;
+  xxh3_hash_long(accumulators, input, length, secret);
+
+  return xxh3_merge_accumulators(accumulators, secret + 11, length * xxh_prime64_1);
+}
+
+fin_forceinline
+static void xxh3_mix32 (Hash_128 &accumulator, const u8 *first, const u8 *second, const u8 *secret, u64 seed) {
+  accumulator.low  += xxh3_mix16(first, secret, seed);
+  accumulator.low  ^= xxh_read64(second) + xxh_read64(second + 8);
+  accumulator.high += xxh3_mix16(second, secret + 16, seed);
+  accumulator.high ^= xxh_read64(first) + xxh_read64(first + 8);
+}
+
+static Hash_128 xxh3_finalize_128 (const Hash_128 &accumulator, usize length, u64 seed) {
+  auto low  = accumulator.low + accumulator.high;
+  auto high = (accumulator.low * xxh_prime64_1) + (accumulator.high * xxh_prime64_4) + ((length - seed) * xxh_prime64_2);
+
+  return Hash_128 { xxh3_avalanche(low), 0 - xxh3_avalanche(high) };
+}
+
+static Hash_128 hash_128 (const void *data, usize length, u64 seed = 0) {
+  auto input  = reinterpret_cast<const u8 *>(data);
+  auto secret = xxh3_default_secret;
+
+  if (length <= 16) {
+    if (length > 8) {
+      auto bitflip_low  = (xxh_read64(secret + 32) ^ xxh_read64(secret + 40)) - seed;
+      auto bitflip_high = (xxh_read64(secret + 48) ^ xxh_read64(secret + 56)) + seed;
+      auto input_low    = xxh_read64(input);
+      auto input_high   = xxh_read64(input + length - 8);
+
+      auto mixed = xxh_multiply_128(input_low ^ input_high ^ bitflip_low, xxh_prime64_1);
+      mixed.low  += static_cast<u64>(length - 1) << 54;
+      input_high ^= bitflip_high;
+      mixed.high += input_high + static_cast<u64>(static_cast<u32>(input_high)) * (xxh_prime32_2 - 1);
+      mixed.low  ^= __builtin_bswap64(mixed.high);
+
+      auto result = xxh_multiply_128(mixed.low, xxh_prime64_2);
+      result.high += mixed.high * xxh_prime64_2;
+
+      return Hash_128 { xxh3_avalanche(result.low), xxh3_avalanche(result.high) };
+    }
+
+    if (length >= 4) {
+      seed ^= static_cast<u64>(__builtin_bswap32(static_cast<u32>(seed))) << 32;
+
+      auto value   = xxh_read32(input) + (static_cast<u64>(xxh_read32(input + length - 4)) << 32);
+      auto bitflip = (xxh_read64(secret + 16) ^ xxh_read64(secret + 24)) + seed;
+
+      auto mixed = xxh_multiply_128(value ^ bitflip, xxh_prime64_1 + (length << 2));
+      mixed.high += mixed.low << 1;
+      mixed.low  ^= mixed.high >> 3;
+      mixed.low  ^= mixed.low >> 35;
+      mixed.low  *= xxh_prime_mx2;
+      mixed.low  ^= mixed.low >> 28;
+
+      return Hash_128 { mixed.low, xxh3_avalanche(mixed.high) };
+    }
+
+    if (length > 0) {
+      u32 combined_low = (static_cast<u32>(input[0]) << 16) | (static_cast<u32>(input[length >> 1]) << 24) |
+                         static_cast<u32>(input[length - 1]) | (static_cast<u32>(length) << 8);
+      u32 combined_high = xxh_rotl32(__builtin_bswap32(combined_low), 13);
+
+      auto bitflip_low  = static_cast<u64>(xxh_read32(secret)     ^ xxh_read32(secret + 4))  + seed;
+      auto bitflip_high = static_cast<u64>(xxh_read32(secret + 8) ^ xxh_read32(secret + 12)) - seed;
+
+      return Hash_128 {
+        xxh64_avalanche(static_cast<u64>(combined_low)  ^ bitflip_low),
+        xxh64_avalanche(static_cast<u64>(combined_high) ^ bitflip_high),
+      };
+    }
+
+    return Hash_128 {
+      xxh64_avalanche(seed ^ xxh_read64(secret + 64) ^ xxh_read64(secret + 72)),
+      xxh64_avalanche(seed ^ xxh_read64(secret + 80) ^ xxh_read64(secret + 88)),
+    };
+  }
+
+  if (length <= 128) {
+    Hash_128 accumulator { length * xxh_prime64_1, 0 };
+
+    if (length > 32) {
+      if (length > 64) {
+        if (length > 96) xxh3_mix32(accumulator, input + 48, input + length - 64, secret + 96, seed);
+        xxh3_mix32(accumulator, input + 32, input + length - 48, secret + 64, seed);
+      }
+      xxh3_mix32(accumulator, input + 16, input + length - 32, secret + 32, seed);
+    }
+    xxh3_mix32(accumulator, input, input + length - 16, secret, seed);
+
+    return xxh3_finalize_128(accumulator, length, seed);
+  }
+
+  if (length <= 240) {
+    Hash_128 accumulator { length * xxh_prime64_1, 0 };
+
+    for (usize idx = 0; idx < 4; idx++)
+      xxh3_mix32(accumulator, input + 32 * idx, input + 32 * idx + 16, secret + 32 * idx, seed);
+
+    accumulator.low  = xxh3_avalanche(accumulator.low);
+    accumulator.high = xxh3_avalanche(accumulator.high);
+
+    for (usize idx = 4; idx < length / 32; idx++)
+      xxh3_mix32(accumulator, input + 32 * idx, input + 32 * idx + 16, secret + 3 + 32 * (idx - 4), seed);
+
+    xxh3_mix32(accumulator, input + length - 16, input + length - 32, secret + 136 - 17 - 16, 0 - seed);
+
+    return xxh3_finalize_128(accumulator, length, seed);
+  }
+
+  alignas(64) u8 derived_secret[xxh3_secret_size];
+  if (seed) {
+    xxh3_derive_secret(derived_secret, seed);
+    secret = derived_secret;
+  }
+
+  alignas(64) u64 accumulators[8] XXH3_INITIAL_ACCUMULATORS;
+  xxh3_hash_long(accumulators, input, length, secret);
+
+  return Hash_128 {
+    xxh3_merge_accumulators(accumulators, secret + 11, length * xxh_prime64_1),
+    xxh3_merge_accumulators(accumulators, secret + xxh3_secret_size - 64 - 11, ~(length * xxh_prime64_2)),
+  };
+}
+
+#undef XXH3_INITIAL_ACCUMULATORS
+
+static u64 hash_64 (String value, u64 seed = 0) {
+  return hash_64(value.value, value.length, seed);
+}
+
+static Hash_128 hash_128 (String value, u64 seed = 0) {
+  return hash_128(value.value, value.length, seed);
+}
+
+constexpr usize blake3_block_size = 64;
+constexpr usize blake3_chunk_size = 1024;
+
+constexpr u32 blake3_iv[8] {
+  0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+constexpr u32 blake3_chunk_start = 1 << 0;
+constexpr u32 blake3_chunk_end   = 1 << 1;
+constexpr u32 blake3_parent      = 1 << 2;
+constexpr u32 blake3_root        = 1 << 3;
+
+fin_forceinline
+static void blake3_mix (u32 *state, usize a, usize b, usize c, usize d, u32 x, u32 y) {
+  const auto rotr = [] (u32 value, u32 shift) { return (value >> shift) | (value << (32 - shift)); };
+
+  state[a] = state[a] + state[b] + x;
+  state[d] = rotr(state[d] ^ state[a], 16);
+  state[c] = state[c] + state[d];
+  state[b] = rotr(state[b] ^ state[c], 12);
+  state[a] = state[a] + state[b] + y;
+  state[d] = rotr(state[d] ^ state[a], 8);
+  state[c] = state[c] + state[d];
+  state[b] = rotr(state[b] ^ state[c], 7);
+}
+
+/*
+  BLAKE3 compression function, only the first half of the output is needed, since extended outputs aren't supported.
+ */
+static void blake3_compress (u32 *chaining_value, const u8 *block, u32 block_length, u64 counter, u32 flags) {
+  constexpr u8 permutation[16] { 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 };
+
+  u32 message[16];
+  for (usize idx = 0; idx < 16; idx++) message[idx] = xxh_read32(block + 4 * idx);
+
+  u32 state[16] {
+    chaining_value[0], chaining_value[1], chaining_value[2], chaining_value[3],
+    chaining_value[4], chaining_value[5], chaining_value[6], chaining_value[7],
+    blake3_iv[0], blake3_iv[1], blake3_iv[2], blake3_iv[3],
+    static_cast<u32>(counter), static_cast<u32>(counter >> 32), block_length, flags,
+  };
+
+  for (usize round = 0; round < 7; round++) {
+    blake3_mix(state, 0, 4,  8, 12, message[0],  message[1]);
+    blake3_mix(state, 1, 5,  9, 13, message[2],  message[3]);
+    blake3_mix(state, 2, 6, 10, 14, message[4],  message[5]);
+    blake3_mix(state, 3, 7, 11, 15, message[6],  message[7]);
+    blake3_mix(state, 0, 5, 10, 15, message[8],  message[9]);
+    blake3_mix(state, 1, 6, 11, 12, message[10], message[11]);
+    blake3_mix(state, 2, 7,  8, 13, message[12], message[13]);
+    blake3_mix(state, 3, 4,  9, 14, message[14], message[15]);
+
+    u32 permuted[16];
+    for (usize idx = 0; idx < 16; idx++) permuted[idx] = message[permutation[idx]];
+    __builtin_memcpy(message, permuted, sizeof(message));
+  }
+
+  for (usize idx = 0; idx < 8; idx++) chaining_value[idx] = state[idx] ^ state[idx + 8];
+}
+
+static void blake3_hash_chunk (u32 *chaining_value, const u8 *input, usize length, u64 chunk_counter, u32 root_flag) {
+  __builtin_memcpy(chaining_value, blake3_iv, sizeof(blake3_iv));
+
+  const usize blocks_count = length ? (length + blake3_block_size - 1) / blake3_block_size : 1;
+
+  for (usize block = 0; block < blocks_count; block++) {
+    const auto offset       = block * blake3_block_size;
+    const auto block_length = (length - offset) < blake3_block_size ? (length - offset) : blake3_block_size;
+    const auto is_last      = (block + 1 == blocks_count);
+
+    u32 flags = 0;
+    if (block == 0) flags |= blake3_chunk_start;
+    if (is_last)    flags |= blake3_chunk_end | root_flag;
+
+    if (block_length == blake3_block_size) {
+      blake3_compress(chaining_value, input + offset, blake3_block_size, chunk_counter, flags);
+      continue;
+    }
+
+    alignas(16) u8 padded[blake3_block_size] {};
+    if (block_length) __builtin_memcpy(padded, input + offset, block_length);
+
+    blake3_compress(chaining_value, padded, block_length, chunk_counter, flags);
+  }
+}
+
+static void blake3_hash_parent (u32 *chaining_value, const u32 *left, const u32 *right, u32 root_flag) {
+  alignas(16) u8 block[blake3_block_size];
+  __builtin_memcpy(block,      left,  32);
+  __builtin_memcpy(block + 32, right, 32);
+
+  __builtin_memcpy(chaining_value, blake3_iv, sizeof(blake3_iv));
+  blake3_compress(chaining_value, block, blake3_block_size, 0, blake3_parent | root_flag);
+}
+
+/*
+  Number of chunks in the left subtree of the node covering `chunks_count` chunks: the largest power of two
+  that leaves at least one chunk on the right.
+ */
+fin_forceinline
+static u64 blake3_left_chunks (u64 chunks_count) {
+  return 1ull << (63 - __builtin_clzll(chunks_count - 1));
+}
+
+static void blake3_hash_subtree (u32 *chaining_value, const u8 *input, usize length, u64 chunk_counter, u32 root_flag) {
+  if (length <= blake3_chunk_size) {
+    blake3_hash_chunk(chaining_value, input, length, chunk_counter, root_flag);
+    return;
+  }
+
+  const auto left_chunks = blake3_left_chunks((length + blake3_chunk_size - 1) / blake3_chunk_size);
+  const auto left_length = left_chunks * blake3_chunk_size;
+
+  u32 left[8], right[8];
+  blake3_hash_subtree(left,  input,               left_length,          chunk_counter,               0);
+  blake3_hash_subtree(right, input + left_length, length - left_length, chunk_counter + left_chunks, 0);
+
+  blake3_hash_parent(chaining_value, left, right, root_flag);
+}
+
+fin_forceinline
+static Hash_256 blake3_make_digest (const u32 *chaining_value) {
+  Hash_256 digest;
+  __builtin_memcpy(digest.bytes, chaining_value, sizeof(digest.bytes));
+  return digest;
+}
+
+/*
+  Input is split into equal subtrees aligned by a power of two chunks, which are hashed by `threads_count`
+  threads independently and joined afterwards, matching BLAKE3's tree layout exactly. With a single thread or
+  for small inputs everything is hashed on the calling thread. Fails only if a worker thread couldn't be joined.
+ */
+static Sys_Result<Hash_256> hash_blake3 (const void *data, usize length, usize threads_count = 1) {
+  auto input = reinterpret_cast<const u8 *>(data);
+
+  constexpr usize threads_limit   = 64;
+  constexpr usize tasks_limit     = 4 * threads_limit + 1;
+  constexpr usize min_task_length = 64 * blake3_chunk_size;
+
+  if (threads_count > threads_limit) threads_count = threads_limit;
+
+  u32 chaining_value[8];
+
+  if (threads_count <= 1 || length <= 2 * min_task_length) {
+    blake3_hash_subtree(chaining_value, input, length, 0, blake3_root);
+    return blake3_make_digest(chaining_value);
+  }
+
+  // Four tasks per thread smooth out differences in threads' progress, the task length is kept a power of two.
+  usize task_length = min_task_length;
+  while (task_length * 4 * threads_count < length) task_length *= 2;
+
+  struct Hash_Context {
+    const u8 *input;
+    usize     length;
+    usize     task_length;
+    usize     tasks_count;
+    ausize    next_task;
+
+    u32 results[tasks_limit][8];
+  };
+
+  Hash_Context context {
+    .input       = input,
+    .length      = length,
+    .task_length = task_length,
+    .tasks_count = (length + task_length - 1) / task_length,
+  };
+
+  const auto hash_worker = [] (Hash_Context *context) {
+    while (true) {
+      auto task = atomic_fetch_add(context->next_task, 1);
+      if (task >= context->tasks_count) return;
+
+      auto offset = task * context->task_length;
+      auto length = (context->length - offset) < context->task_length ? (context->length - offset) : context->task_length;
+
+      blake3_hash_subtree(context->results[task], context->input + offset, length, offset / blake3_chunk_size, 0);
+    }
+  };
+
+  Thread workers[threads_limit];
+  usize spawned_count = 0;
+
+  for (; spawned_count < threads_count - 1; spawned_count++) {
+    auto [error, thread] = spawn_thread(hash_worker, &context);
+    if (error) break;
+    workers[spawned_count] = thread;
+  }
+
+  hash_worker(&context);
+
+  // Every worker is joined before leaving, since those still running reference the context on this stack.
+  Sys_Result<void> status = Ok();
+  for (usize idx = 0; idx < spawned_count; idx++) {
+    auto result = wait_for_thread(workers[idx]);
+    if (result.is_error() && status.is_ok()) status = move(result);
+  }
+
+  fin_check(move(status));
+
+  /*
+    Subtrees above the tasks follow the same split as blake3_hash_subtree, with task results as leaves.
+   */
+  const auto join = [&context] (this auto self, u32 *output, usize offset, usize length, u32 root_flag) -> void {
+    if (length <= context.task_length) {
+      __builtin_memcpy(output, context.results[offset / context.task_length], 32);
+      return;
+    }
+
+    const auto left_chunks = blake3_left_chunks((length + blake3_chunk_size - 1) / blake3_chunk_size);
+    const auto left_length = left_chunks * blake3_chunk_size;
+
+    u32 left[8], right[8];
+    self(left,  offset,               left_length,          0);
+    self(right, offset + left_length, length - left_length, 0);
+
+    blake3_hash_parent(output, left, right, root_flag);
+  };
+
+  join(chaining_value, 0, length, blake3_root);
+
+  return blake3_make_digest(chaining_value);
+}
+
+static Sys_Result<Hash_256> hash_blake3 (String value, usize threads_count = 1) {
+  return hash_blake3(value.value, value.length, threads_count);
+}
+
+/*
+  Hash the file's content through a memory mapping, without copying it into intermediate buffers.
+ */
+static Sys_Result<Hash_128> hash_file_128 (const File &file) {
+  auto [error, mapping] = map_file_into_memory(file);
+  if (error) return move(error.value);
+
+  auto hash = hash_128(mapping.memory, mapping.size);
+
+  fin_check(unmap_file(mapping));
+
+  return hash;
+}
+
+/*
+  Same as hash_file_128 using BLAKE3, the mapped content is hashed by `threads_count` threads, defaults to the
+  number of logical cores.
+ */
+static Sys_Result<Hash_256> hash_file_blake3 (const File &file, usize threads_count = 0) {
+  if (threads_count == 0) threads_count = get_logical_cpu_count();
+
+  auto [error, mapping] = map_file_into_memory(file);
+  if (error) return move(error.value);
+
+  auto [hash_error, hash] = hash_blake3(mapping.memory, mapping.size, threads_count);
+
+  fin_check(unmap_file(mapping));
+
+  if (hash_error) return move(hash_error.value);
+
+  return move(hash);
+}
+
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/arena.hpp"
+#include "anyfin/buffered_writer.hpp"
+#include "anyfin/memory.hpp"
+#include "anyfin/option.hpp"
+#include "anyfin/platform.hpp"
+#include "anyfin/strings.hpp"
+
+namespace Fin {
+
+/*
+  Histogram of latencies (or any other u64 values) in the HDR style: values below 2^precision_bits are counted
+  exactly, above that each power of two range is split into 2^(precision_bits - 1) linear buckets, which bounds
+  the relative error of reported values by 2^-(precision_bits - 1), i.e under 1.6% with the default 7 bits.
+
+  The histogram has a fixed size and recording a value is a few arithmetic instructions and an increment,
+  without synchronization: each thread records into its own histogram, which are merged for the reports.
+  Values are unit-agnostic, e.g. timer ticks or nanoseconds.
+ */
+struct Latency_Histogram {
+  u64 *counts;
+  u32  buckets_count;
+  u32  precision_bits;
+
+  u64 total_count;
+  u64 total_sum;
+  u64 min_value;
+  u64 max_value;
+};
+
+constexpr u32 get_histogram_buckets_count (u32 precision_bits) {
+  return (66 - precision_bits) << (precision_bits - 1);
+}
+
+/*
+  Allocates the buckets from the arena, returns none if there's not enough space for them.
+ */
+static Option<Latency_Histogram> create_histogram (Memory_Arena &arena, u32 precision_bits = 7) {
+  fin_ensure(precision_bits >= 2 && precision_bits <= 16);
+
+  auto buckets_count = get_histogram_buckets_count(precision_bits);
+
+  auto counts = reserve<u64>(arena, sizeof(u64) * buckets_count);
+  if (!counts) return opt_none;
+
+  zero_memory(counts, buckets_count);
+
+  return Latency_Histogram {
+    .counts         = counts,
+    .buckets_count  = buckets_count,
+    .precision_bits = precision_bits,
+    .min_value      = static_cast<u64>(-1),
+  };
+}
+
+static void reset_histogram (Latency_Histogram &histogram) {
+  zero_memory(histogram.counts, histogram.buckets_count);
+
+  histogram.total_count = 0;
+  histogram.total_sum   = 0;
+  histogram.min_value   = static_cast<u64>(-1);
+  histogram.max_value   = 0;
+}
+
+fin_forceinline
+static u32 get_bucket_index (const Latency_Histogram &histogram, u64 value) {
+  auto precision = histogram.precision_bits;
+  if (value < (1ull << precision)) return static_cast<u32>(value);
+
+  auto shift = static_cast<u32>(63 - __builtin_clzll(value)) - (precision - 1);
+  return (shift << (precision - 1)) + static_cast<u32>(value >> shift);
+}
+
+/*
+  Range of values [lowest, highest] counted by the bucket.
+ */
+static void get_bucket_range (const Latency_Histogram &histogram, u32 index, u64 &lowest, u64 &highest) {
+  auto precision = histogram.precision_bits;
+  if (index < (1u << precision)) {
+    lowest = highest = index;
+    return;
+  }
+
+  auto shift      = (index >> (precision - 1)) - 1;
+  auto sub_bucket = static_cast<u64>(index - (shift << (precision - 1)));
+
+  lowest  = sub_bucket << shift;
+  highest = lowest + ((1ull << shift) - 1);
+}
+
+fin_forceinline
+static void record_value (Latency_Histogram &histogram, u64 value, u64 count = 1) {
+  histogram.counts[get_bucket_index(histogram, value)] += count;
+
+  histogram.total_count += count;
+  histogram.total_sum   += value * count;
+
+  if (value < histogram.min_value) histogram.min_value = value;
+  if (value > histogram.max_value) histogram.max_value = value;
+}
+
+/*
+  Add the counts of `source` into `target`, both must have the same precision. The source is read without
+  synchronization, thus it should be merged once its thread is done recording, or otherwise the report may
+  miss the values recorded concurrently.
+ */
+static void merge_histograms (Latency_Histogram &target, const Latency_Histogram &source) {
+  fin_ensure(target.precision_bits == source.precision_bits);
+
+  for (u32 idx = 0; idx < source.buckets_count; idx++) target.counts[idx] += source.counts[idx];
+
+  target.total_count += source.total_count;
+  target.total_sum   += source.total_sum;
+
+  if (source.min_value < target.min_value) target.min_value = source.min_value;
+  if (source.max_value > target.max_value) target.max_value = source.max_value;
+}
+
+/*
+  Value below or at which the given percentage of the recorded values is, e.g 99.9 for p999. Reported as the
+  highest value of the bucket the percentile falls into, so it's never below the actual one.
+ */
+static u64 get_value_at_percentile (const Latency_Histogram &histogram, double percentile) {
+  if (histogram.total_count == 0) return 0;
+
+  if (percentile > 100.0) percentile = 100.0;
+
+  auto target = static_cast<u64>(percentile / 100.0 * static_cast<double>(histogram.total_count) + 0.5);
+  if (target == 0) target = 1;
+
+  u64 seen = 0;
+  for (u32 idx = 0; idx < histogram.buckets_count; idx++) {
+    seen += histogram.counts[idx];
+    if (seen < target) continue;
+
+    u64 lowest, highest;
+    get_bucket_range(histogram, idx, lowest, highest);
+
+    return highest < histogram.max_value ? highest : histogram.max_value;
+  }
+
+  return histogram.max_value;
+}
+
+static u64 get_mean_value (const Latency_Histogram &histogram) {
+  return histogram.total_count ? histogram.total_sum / histogram.total_count : 0;
+}
+
+struct Histogram_Percentile {
+  double value;
+  String label;
+};
+
+constexpr Histogram_Percentile reported_percentiles[] {
+  { 50.0, "50" }, { 90.0, "90" }, { 99.0, "99" }, { 99.9, "99.9" }, { 99.99, "99.99" },
+};
+
+/*
+  Short human-readable summary: count, min, mean, max and the common percentiles, one per line.
+ */
+static Sys_Result<void> write_histogram_text (Buffered_Writer &writer, const Latency_Histogram &histogram) {
+  char count_buffer[24], min_buffer[24], mean_buffer[24], max_buffer[24];
+
+  String summary[] {
+    "count: ", render_unsigned(count_buffer, histogram.total_count),
+    "\nmin:   ", render_unsigned(min_buffer, histogram.total_count ? histogram.min_value : 0),
+    "\nmean:  ", render_unsigned(mean_buffer, get_mean_value(histogram)),
+    "\nmax:   ", render_unsigned(max_buffer, histogram.max_value),
+    "\n",
+  };
+  fin_check(buffered_write(writer, Slice(summary)));
+
+  for (auto &percentile: reported_percentiles) {
+    char value_buffer[24];
+
+    String line[] {
+      "p", percentile.label, ": ", render_unsigned(value_buffer, get_value_at_percentile(histogram, percentile.value)), "\n",
+    };
+    fin_check(buffered_write(writer, Slice(line)));
+  }
+
+  return Ok();
+}
+
+/*
+  Summary and percentiles as in the text form, followed by all non-empty buckets as [lowest, highest, count]
+  triples, which is enough to rebuild the distribution elsewhere.
+ */
+static Sys_Result<void> write_histogram_json (Buffered_Writer &writer, const Latency_Histogram &histogram) {
+  char count_buffer[24], min_buffer[24], mean_buffer[24], max_buffer[24];
+
+  String summary[] {
+    "{\"count\":", render_unsigned(count_buffer, histogram.total_count),
+    ",\"min\":",   render_unsigned(min_buffer, histogram.total_count ? histogram.min_value : 0),
+    ",\"mean\":",  render_unsigned(mean_buffer, get_mean_value(histogram)),
+    ",\"max\":",   render_unsigned(max_buffer, histogram.max_value),
+    ",\"percentiles\":{",
+  };
+  fin_check(buffered_write(writer, Slice(summary)));
+
+  bool is_first = true;
+  for (auto &percentile: reported_percentiles) {
+    char value_buffer[24];
+
+    String entry[] {
+      is_first ? "\"" : ",\"", percentile.label, "\":",
+      render_unsigned(value_buffer, get_value_at_percentile(histogram, percentile.value)),
+    };
+    fin_check(buffered_write(writer, Slice(entry)));
+
+    is_first = false;
+  }
+
+  fin_check(buffered_write(writer, "},\"buckets\":["));
+
+  is_first = true;
+  for (u32 idx = 0; idx < histogram.buckets_count; idx++) {
+    if (!histogram.counts[idx]) continue;
+
+    u64 lowest, highest;
+    get_bucket_range(histogram, idx, lowest, highest);
+
+    char lowest_buffer[24], highest_buffer[24], bucket_count_buffer[24];
+
+    String bucket[] {
+      is_first ? "[" : ",[",
+      render_unsigned(lowest_buffer, lowest), ",",
+      render_unsigned(highest_buffer, highest), ",",
+      render_unsigned(bucket_count_buffer, histogram.counts[idx]), "]",
+    };
+    fin_check(buffered_write(writer, Slice(bucket)));
+
+    is_first = false;
+  }
+
+  return buffered_write(writer, "]}");
+}
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/arena.hpp"
+#include "anyfin/platform.hpp"
+#include "anyfin/strings.hpp"
+
+namespace Fin {
+
+/*
+  Client and host of the GNU make jobserver protocol, which limits the number of jobs running across the whole
+  process tree. The jobserver is a pipe (or a named fifo) holding one byte per available job slot: a job takes
+  a token by reading a byte and returns it by writing the same byte back once finished. Each process also owns
+  one implicit token, which is never passed through the pipe, so a process can always run at least one job.
+
+  Make-aware children find the jobserver through the MAKEFLAGS variable and inherited descriptors.
+ */
+struct Jobserver {
+  int read_descriptor  = -1; // Opened privately in non-blocking mode, doesn't affect other clients
+  int write_descriptor = -1;
+
+  /*
+    Descriptors owned by this process, which are closed by destroy. The pipe's ends are inherited by children
+    when hosting, thus aren't close-on-exec.
+   */
+  int owned_descriptors[3] { -1, -1, -1 };
+
+  /*
+    "MAKEFLAGS=..." entry for the Command's environment, set only when hosting. Children of a joined jobserver
+    inherit MAKEFLAGS from the current environment.
+   */
+  String makeflags;
+};
+
+fin_forceinline
+static bool is_active (const Jobserver &jobserver) {
+  return jobserver.read_descriptor >= 0;
+}
+
+/*
+  Join the jobserver advertised in MAKEFLAGS through --jobserver-auth (or the older --jobserver-fds), either as
+  "R,W" descriptors or "fifo:PATH". If there's no jobserver, or make didn't pass its descriptors to this process
+  (e.g the recipe isn't marked as recursive), the returned jobserver isn't active.
+ */
+static Sys_Result<Jobserver> join_jobserver ();
+
+/*
+  Host a new jobserver with `slots_count` job slots in total, including the implicit one of this process.
+  MAKEFLAGS value is placed into the arena.
+ */
+static Sys_Result<Jobserver> create_jobserver (Memory_Arena &arena, u32 slots_count);
+
+static Sys_Result<void> destroy (Jobserver &jobserver);
+
+/*
+  Take a token if one is available right away, returns false otherwise. The token must be given back with
+  release_token, passing the same value.
+ */
+static Sys_Result<bool> try_acquire_token (Jobserver &jobserver, char &token);
+
+/*
+  Wait for a token up to `timeout_millis`, or indefinitely if negative. Returns false if the time ran out.
+ */
+static Sys_Result<bool> acquire_token (Jobserver &jobserver, char &token, s32 timeout_millis = -1);
+
+static Sys_Result<void> release_token (Jobserver &jobserver, char token);
+
+}
+
+#ifndef FIN_JOBSERVER_HPP_IMPL
+  #ifdef PLATFORM_LINUX
+    #include "anyfin/jobserver_linux.hpp"
+  #else
+    #error "Unsupported platform"
+  #endif
+#endif
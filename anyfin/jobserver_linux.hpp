@@ -0,0 +1,233 @@
+
+#define FIN_JOBSERVER_HPP_IMPL
+
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "anyfin/format.hpp"
+#include "anyfin/jobserver.hpp"
+
+namespace Fin {
+
+/*
+  Reopening the pipe through procfs creates a new open file description, so the non-blocking mode set on it
+  isn't shared with other processes using the same pipe, which may rely on blocking reads.
+ */
+static int open_private_reader (int descriptor) {
+  const String prefix = "/proc/self/fd/";
+
+  char digits[24];
+  auto number = render_unsigned(digits, static_cast<u64>(descriptor));
+
+  char path[64];
+  copy_memory(path, prefix.value, prefix.length);
+  copy_memory(path + prefix.length, number.value, number.length);
+  path[prefix.length + number.length] = '\0';
+
+  return open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+}
+
+static bool parse_descriptor (String &text, int &descriptor) {
+  usize length = 0;
+  int   value  = 0;
+
+  while (length < text.length && text[length] >= '0' && text[length] <= '9') {
+    value   = value * 10 + (text[length] - '0');
+    length += 1;
+  }
+
+  if (length == 0) return false;
+
+  text.value  += length;
+  text.length -= length;
+  descriptor   = value;
+
+  return true;
+}
+
+static Sys_Result<Jobserver> join_jobserver () {
+  auto makeflags = getenv("MAKEFLAGS");
+  if (!makeflags) return Jobserver {};
+
+  /*
+    The last option wins, same as make does it, since parents prepend their flags to the ones inherited.
+   */
+  String auth;
+
+  auto flags = String(cast_bytes(makeflags));
+  while (!is_empty(flags)) {
+    auto word_end = get_character_offset(flags.value, flags.length, ' ');
+    auto word     = String(flags.value, word_end ? word_end - flags.value : flags.length);
+
+    flags.value  += word.length;
+    flags.length -= word.length;
+    if (word_end) {
+      flags.value  += 1;
+      flags.length -= 1;
+    }
+
+    String options[] { "--jobserver-auth=", "--jobserver-fds=" };
+    for (auto &option: options) {
+      if (starts_with(word, option)) auth = String(word.value + option.length, word.length - option.length);
+    }
+  }
+
+  if (is_empty(auth)) return Jobserver {};
+
+  Jobserver jobserver;
+
+  if (starts_with(auth, "fifo:")) {
+    char path[PATH_MAX];
+
+    auto path_length = auth.length - 5;
+    if (path_length >= sizeof(path)) return System_Error { "jobserver's fifo path is too long", ENAMETOOLONG };
+
+    copy_memory(path, auth.value + 5, path_length);
+    path[path_length] = '\0';
+
+    auto reader = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (reader < 0) return get_system_error();
+
+    auto writer = open(path, O_WRONLY | O_CLOEXEC);
+    if (writer < 0) {
+      auto error = get_system_error();
+      close(reader);
+      return error;
+    }
+
+    jobserver.read_descriptor  = reader;
+    jobserver.write_descriptor = writer;
+    jobserver.owned_descriptors[0] = reader;
+    jobserver.owned_descriptors[1] = writer;
+
+    return jobserver;
+  }
+
+  int read_end, write_end;
+  if (!parse_descriptor(auth, read_end) || auth.length < 2 || auth[0] != ',') return Jobserver {};
+
+  auth.value  += 1;
+  auth.length -= 1;
+  if (!parse_descriptor(auth, write_end)) return Jobserver {};
+
+  // Make keeps MAKEFLAGS for recipes that aren't marked as recursive, but doesn't pass the descriptors.
+  if (fcntl(read_end, F_GETFD) < 0 || fcntl(write_end, F_GETFD) < 0) return Jobserver {};
+
+  auto reader = open_private_reader(read_end);
+  if (reader < 0) return get_system_error();
+
+  jobserver.read_descriptor      = reader;
+  jobserver.write_descriptor     = write_end;
+  jobserver.owned_descriptors[0] = reader;
+
+  return jobserver;
+}
+
+static Sys_Result<Jobserver> create_jobserver (Memory_Arena &arena, u32 slots_count) {
+  fin_ensure(slots_count > 0);
+
+  int pipe_ends[2];
+  if (pipe(pipe_ends) != 0) return get_system_error();
+
+  Jobserver jobserver {
+    .write_descriptor  = pipe_ends[1],
+    .owned_descriptors = { pipe_ends[0], pipe_ends[1], -1 },
+  };
+
+  const auto fail = [&] () -> System_Error {
+    auto error = get_system_error();
+    destroy(jobserver);
+    return error;
+  };
+
+  jobserver.read_descriptor      = open_private_reader(pipe_ends[0]);
+  jobserver.owned_descriptors[2] = jobserver.read_descriptor;
+  if (jobserver.read_descriptor < 0) return fail();
+
+  // The pipe's capacity is way above any sensible number of slots, writes won't block.
+  for (u32 idx = 1; idx < slots_count; idx++) {
+    char token = '+';
+    if (write(jobserver.write_descriptor, &token, 1) != 1) return fail();
+  }
+
+  jobserver.makeflags = format_string(arena, "MAKEFLAGS= -j% --jobserver-auth=%,%", slots_count, pipe_ends[0], pipe_ends[1]);
+
+  return jobserver;
+}
+
+static Sys_Result<void> destroy (Jobserver &jobserver) {
+  bool has_failed = false;
+  for (auto descriptor: jobserver.owned_descriptors) {
+    if (descriptor >= 0) has_failed |= (close(descriptor) != 0);
+  }
+
+  jobserver = Jobserver {};
+
+  if (has_failed) return get_system_error();
+
+  return Ok();
+}
+
+static Sys_Result<bool> try_acquire_token (Jobserver &jobserver, char &token) {
+  while (true) {
+    auto bytes_read = read(jobserver.read_descriptor, &token, 1);
+    if (bytes_read == 1) return true;
+
+    if (bytes_read < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN) return false;
+      return get_system_error();
+    }
+
+    return System_Error { "jobserver's pipe has been closed", EPIPE };
+  }
+}
+
+static Sys_Result<bool> acquire_token (Jobserver &jobserver, char &token, s32 timeout_millis) {
+  const auto get_now_millis = [] () -> u64 {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<u64>(now.tv_sec) * 1000 + static_cast<u64>(now.tv_nsec) / 1000000;
+  };
+
+  // Fixed upfront, so that the wakeups which lose the token to other clients don't extend the wait.
+  const u64 deadline = timeout_millis > 0 ? get_now_millis() + timeout_millis : 0;
+
+  while (true) {
+    auto [error, acquired] = try_acquire_token(jobserver, token);
+    if (error) return move(error.value);
+    if (acquired) return true;
+
+    // Other clients may take the token between the wakeup and the read, in which case it's back to waiting.
+    auto remaining = timeout_millis;
+    if (timeout_millis > 0) {
+      auto now = get_now_millis();
+      if (now >= deadline) return false;
+
+      remaining = static_cast<s32>(deadline - now);
+    }
+
+    pollfd request { .fd = jobserver.read_descriptor, .events = POLLIN };
+    auto status = poll(&request, 1, remaining);
+    if (status < 0) {
+      if (errno == EINTR) continue;
+      return get_system_error();
+    }
+
+    if (status == 0) return false;
+  }
+}
+
+static Sys_Result<void> release_token (Jobserver &jobserver, char token) {
+  while (write(jobserver.write_descriptor, &token, 1) != 1) {
+    if (errno != EINTR) return get_system_error();
+  }
+
+  return Ok();
+}
+
+}
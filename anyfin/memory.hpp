@@ -4,10 +4,21 @@
 #include "anyfin/base.hpp"
 #include "anyfin/meta.hpp" // for the is_pointer check is align function
 
+#ifdef CPU_ARCH_X64
+  #include <cpuid.h>
+  #include <immintrin.h>
+#endif
+
+#ifdef PLATFORM_LINUX
+  // glibc declares these with its own exception specifications, which must match.
+  #include <string.h>
+#else
 extern "C" {
 void * memset (void *destination, int value, size_t count);
 void * memcpy (void *destination, const void *source, size_t count);
+void * memmove (void *destination, const void *source, size_t count);
 }
+#endif
 
 namespace Fin {
 
@@ -33,6 +44,14 @@ constexpr auto copy_memory (T *destination, const T *source, const usize count)
   return __builtin_memcpy(destination, source, sizeof(T) * count);
 }
 
+/*
+  Same as copy_memory, but the source and destination regions are allowed to overlap.
+ */
+template <typename T>
+constexpr auto move_memory (T *destination, const T *source, const usize count) {
+  return __builtin_memmove(destination, source, sizeof(T) * count);
+}
+
 template <typename T>
 constexpr void zero_memory (T *memory, const usize count = 1) {
   __builtin_memset(memory, 0, sizeof(T) * count);
@@ -43,22 +62,199 @@ constexpr bool compare_bytes (const T *a, const T *b, const usize count) {
   return (__builtin_memcmp(a, b, sizeof(T) * count) == 0);
 }
 
-static const char * get_character_offset (const char *memory, const usize length, const char value) {
-  fin_ensure(memory);
+#ifdef CPU_ARCH_X64
 
-  if (length == 0) return nullptr;
+#define fin_target_avx2 __attribute__((target("avx2")))
+
+/*
+  Besides the CPU, the OS must preserve the YMM registers on context switches for AVX2 to be usable.
+ */
+static bool is_avx2_supported () {
+#ifdef __AVX2__
+  return true;
+#else
+  u32 eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+
+  constexpr u32 osxsave = 1u << 27, avx = 1u << 28;
+  if ((ecx & (osxsave | avx)) != (osxsave | avx)) return false;
+
+  u32 xcr0_low, xcr0_high;
+  asm volatile ("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+  if ((xcr0_low & 0b110) != 0b110) return false;
+
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+
+  return ebx & (1u << 5);
+#endif
+}
+
+/*
+  Detected during the static initialization, code running before that takes the SSE2 paths.
+ */
+static const bool is_avx2_available = is_avx2_supported();
+
+/*
+  Byte search kernels. All of them expect at least one full vector of input: the unaligned head (or tail, for
+  the reversed search) is checked first, then the rest is scanned with aligned loads, finishing with an unaligned
+  load that overlaps the already checked bytes, which are known not to match. Memory outside of the range is
+  never touched.
+ */
+
+fin_forceinline
+static u32 match_bytes_sse2 (__m128i chunk, const __m128i *needles, usize needles_count) {
+  auto matches = _mm_cmpeq_epi8(chunk, needles[0]);
+  for (usize idx = 1; idx < needles_count; idx++) matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chunk, needles[idx]));
+
+  return static_cast<u32>(_mm_movemask_epi8(matches));
+}
+
+fin_target_avx2 fin_forceinline
+static u32 match_bytes_avx2 (__m256i chunk, const __m256i *needles, usize needles_count) {
+  auto matches = _mm256_cmpeq_epi8(chunk, needles[0]);
+  for (usize idx = 1; idx < needles_count; idx++) matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(chunk, needles[idx]));
+
+  return static_cast<u32>(_mm256_movemask_epi8(matches));
+}
+
+static const char * find_bytes_sse2 (const char *memory, const char *end, const char *values, usize values_count) {
+  __m128i needles[16] { _mm_set1_epi8(values[0]) };
+  for (usize idx = 1; idx < values_count; idx++) needles[idx] = _mm_set1_epi8(values[idx]);
+
+  if (auto mask = match_bytes_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(memory)), needles, values_count))
+    return memory + __builtin_ctz(mask);
+
+  auto cursor = memory + (16 - (reinterpret_cast<usize>(memory) & 15));
+  for (; end - cursor >= 16; cursor += 16) {
+    if (auto mask = match_bytes_sse2(_mm_load_si128(reinterpret_cast<const __m128i *>(cursor)), needles, values_count))
+      return cursor + __builtin_ctz(mask);
+  }
+
+  if (cursor < end) {
+    if (auto mask = match_bytes_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(end - 16)), needles, values_count))
+      return end - 16 + __builtin_ctz(mask);
+  }
+
+  return nullptr;
+}
+
+fin_target_avx2
+static const char * find_bytes_avx2 (const char *memory, const char *end, const char *values, usize values_count) {
+  __m256i needles[16] { _mm256_set1_epi8(values[0]) };
+  for (usize idx = 1; idx < values_count; idx++) needles[idx] = _mm256_set1_epi8(values[idx]);
+
+  if (auto mask = match_bytes_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(memory)), needles, values_count))
+    return memory + __builtin_ctz(mask);
+
+  auto cursor = memory + (32 - (reinterpret_cast<usize>(memory) & 31));
+  for (; end - cursor >= 32; cursor += 32) {
+    if (auto mask = match_bytes_avx2(_mm256_load_si256(reinterpret_cast<const __m256i *>(cursor)), needles, values_count))
+      return cursor + __builtin_ctz(mask);
+  }
+
+  if (cursor < end) {
+    if (auto mask = match_bytes_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(end - 32)), needles, values_count))
+      return end - 32 + __builtin_ctz(mask);
+  }
+
+  return nullptr;
+}
+
+static const char * find_bytes_reversed_sse2 (const char *memory, const char *end, const char *values, usize values_count) {
+  __m128i needles[16] { _mm_set1_epi8(values[0]) };
+  for (usize idx = 1; idx < values_count; idx++) needles[idx] = _mm_set1_epi8(values[idx]);
+
+  if (auto mask = match_bytes_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(end - 16)), needles, values_count))
+    return end - 16 + (31 - __builtin_clz(mask));
+
+  // Addresses are compared as integers, since the cursor ends up below the start of the range.
+  auto start  = reinterpret_cast<usize>(memory);
+  auto cursor = (reinterpret_cast<usize>(end) - 16) & ~usize(15);
+  for (; cursor >= start; cursor -= 16) {
+    if (auto mask = match_bytes_sse2(_mm_load_si128(reinterpret_cast<const __m128i *>(cursor)), needles, values_count))
+      return reinterpret_cast<const char *>(cursor) + (31 - __builtin_clz(mask));
+  }
+
+  if (cursor + 16 > start) {
+    if (auto mask = match_bytes_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(memory)), needles, values_count))
+      return memory + (31 - __builtin_clz(mask));
+  }
 
-  auto end = memory + length;
+  return nullptr;
+}
+
+fin_target_avx2
+static const char * find_bytes_reversed_avx2 (const char *memory, const char *end, const char *values, usize values_count) {
+  __m256i needles[16] { _mm256_set1_epi8(values[0]) };
+  for (usize idx = 1; idx < values_count; idx++) needles[idx] = _mm256_set1_epi8(values[idx]);
+
+  if (auto mask = match_bytes_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(end - 32)), needles, values_count))
+    return end - 32 + (31 - __builtin_clz(mask));
+
+  auto start  = reinterpret_cast<usize>(memory);
+  auto cursor = (reinterpret_cast<usize>(end) - 32) & ~usize(31);
+  for (; cursor >= start; cursor -= 32) {
+    if (auto mask = match_bytes_avx2(_mm256_load_si256(reinterpret_cast<const __m256i *>(cursor)), needles, values_count))
+      return reinterpret_cast<const char *>(cursor) + (31 - __builtin_clz(mask));
+  }
+
+  if (cursor + 32 > start) {
+    if (auto mask = match_bytes_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(memory)), needles, values_count))
+      return memory + (31 - __builtin_clz(mask));
+  }
+
+  return nullptr;
+}
+
+#endif
+
+/*
+  Offset of the first byte in the range equal to any of the `values`, of which there could be up to 16.
+ */
+static const char * find_any_byte (const char *memory, const char *end, const char *values, usize values_count) {
+  fin_ensure(values_count > 0 && values_count <= 16);
+
+#ifdef CPU_ARCH_X64
+  if (end - memory >= 32 && is_avx2_available) return find_bytes_avx2(memory, end, values, values_count);
+  if (end - memory >= 16)                      return find_bytes_sse2(memory, end, values, values_count);
+#endif
+
+  for (auto cursor = memory; cursor < end; cursor++) {
+    for (usize idx = 0; idx < values_count; idx++) {
+      if (*cursor == values[idx]) return cursor;
+    }
+  }
+
+  return nullptr;
+}
+
+static const char * find_any_byte_reversed (const char *memory, const char *end, const char *values, usize values_count) {
+  fin_ensure(values_count > 0 && values_count <= 16);
+
+#ifdef CPU_ARCH_X64
+  if (end - memory >= 32 && is_avx2_available) return find_bytes_reversed_avx2(memory, end, values, values_count);
+  if (end - memory >= 16)                      return find_bytes_reversed_sse2(memory, end, values, values_count);
+#endif
+
+  for (auto cursor = end; cursor > memory;) {
+    cursor -= 1;
 
-  auto cursor = memory;
-  while (cursor < end) {
-    if (*cursor == value) return cursor;
-    cursor += 1;
+    for (usize idx = 0; idx < values_count; idx++) {
+      if (*cursor == values[idx]) return cursor;
+    }
   }
 
   return nullptr;
 }
 
+static const char * get_character_offset (const char *memory, const usize length, const char value) {
+  fin_ensure(memory);
+
+  if (length == 0) return nullptr;
+
+  return find_any_byte(memory, memory + length, &value, 1);
+}
+
 fin_forceinline
 static const char * get_character_offset (const char *memory, const char *end, const char value) {
   return get_character_offset(memory, end - memory, value);
@@ -66,11 +262,37 @@ static const char * get_character_offset (const char *memory, const char *end, c
 
 static auto get_character_offset_reversed (Byte_Type auto *memory, const usize length, const char value) -> decltype(memory) {
   if (!memory || length == 0) [[unlikely]] return nullptr;
-  for (auto cursor = (memory + length - 1); cursor >= memory; cursor--) {
-    if (*cursor == value) return cursor;
-  }
 
-  return nullptr;
+  auto start  = reinterpret_cast<const char *>(memory);
+  auto result = find_any_byte_reversed(start, start + length, &value, 1);
+
+  return result ? memory + (result - start) : nullptr;
+}
+
+/*
+  Multi-needle variants, finding the first (or the last) occurrence of any of the `values`, e.g. any of the path
+  separators. Up to 16 values are supported.
+ */
+static const char * get_any_character_offset (const char *memory, const usize length, const char *values, const usize values_count) {
+  fin_ensure(memory);
+
+  if (length == 0) return nullptr;
+
+  return find_any_byte(memory, memory + length, values, values_count);
+}
+
+fin_forceinline
+static const char * get_any_character_offset (const char *memory, const char *end, const char *values, const usize values_count) {
+  return get_any_character_offset(memory, end - memory, values, values_count);
+}
+
+static auto get_any_character_offset_reversed (Byte_Type auto *memory, const usize length, const char *values, const usize values_count) -> decltype(memory) {
+  if (!memory || length == 0) [[unlikely]] return nullptr;
+
+  auto start  = reinterpret_cast<const char *>(memory);
+  auto result = find_any_byte_reversed(start, start + length, values, values_count);
+
+  return result ? memory + (result - start) : nullptr;
 }
 
 struct Memory_Region {
@@ -87,6 +309,8 @@ static void free_virtual_memory (Memory_Region &region);
 #ifndef FIN_MEMORY_HPP_IMPL
   #ifdef PLATFORM_WIN32
     #include "anyfin/memory_win32.hpp"
+  #elif defined(PLATFORM_LINUX)
+    #include "anyfin/memory_linux.hpp"
   #else
     #error "Unsupported platform"
   #endif
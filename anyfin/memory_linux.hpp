@@ -0,0 +1,24 @@
+
+#define FIN_MEMORY_HPP_IMPL
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "anyfin/memory.hpp"
+
+namespace Fin {
+
+static Memory_Region reserve_virtual_memory (usize size) {
+  const auto aligned_size = align_forward(size, static_cast<usize>(sysconf(_SC_PAGESIZE)));
+
+  auto memory = mmap(nullptr, aligned_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) return Memory_Region {};
+
+  return Memory_Region { (u8 *) memory, aligned_size };
+}
+
+static void free_virtual_memory (Memory_Region &memory) {
+  munmap(memory.memory, memory.size);
+}
+
+}
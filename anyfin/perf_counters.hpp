@@ -0,0 +1,78 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/platform.hpp"
+
+namespace Fin {
+
+enum struct Perf_Counter: u32 {
+  Cycles,
+  Instructions,
+  Cache_Misses,
+  Branch_Misses,
+  TLB_Misses,
+};
+
+constexpr usize perf_counters_count = 5;
+
+constexpr const char *perf_counter_names[perf_counters_count] {
+  "cycles", "instructions", "cache_misses", "branch_misses", "tlb_misses",
+};
+
+/*
+  Hardware counters of the calling thread, opened as a single group, so that all values cover exactly the
+  same interval. Counters the CPU (or VM) doesn't support are left out, the mask tells which are present.
+ */
+struct Perf_Counter_Group {
+  s32 descriptors[perf_counters_count] { -1, -1, -1, -1, -1 };
+  u32 available_mask = 0;
+};
+
+/*
+  Counter values, unavailable counters read as zero. When the kernel had to multiplex the counters with other
+  users of the PMU, values are scaled by the share of time the group was actually counting.
+ */
+struct Perf_Counter_Values {
+  u64 values[perf_counters_count] {};
+  u32 available_mask = 0;
+
+  u64 operator [] (Perf_Counter counter) const { return values[static_cast<u32>(counter)]; }
+};
+
+fin_forceinline
+static bool has_counter (u32 available_mask, Perf_Counter counter) {
+  return available_mask & (1u << static_cast<u32>(counter));
+}
+
+/*
+  Open the counters for the calling thread, only user-space events are counted. Fails if none could be opened,
+  e.g. when perf events are restricted by kernel.perf_event_paranoid or the platform has no access to the PMU,
+  callers are expected to carry on without the counters in that case.
+ */
+static Sys_Result<Perf_Counter_Group> open_perf_counters ();
+
+static Sys_Result<void> close_perf_counters (Perf_Counter_Group &group);
+
+static Perf_Counter_Values read_perf_counters (const Perf_Counter_Group &group);
+
+static Perf_Counter_Values get_counter_deltas (const Perf_Counter_Values &from, const Perf_Counter_Values &to) {
+  Perf_Counter_Values deltas { .available_mask = from.available_mask & to.available_mask };
+
+  for (usize idx = 0; idx < perf_counters_count; idx++) {
+    if (deltas.available_mask & (1u << idx)) deltas.values[idx] = to.values[idx] - from.values[idx];
+  }
+
+  return deltas;
+}
+
+}
+
+#ifndef FIN_PERF_COUNTERS_HPP_IMPL
+  #ifdef PLATFORM_WIN32
+    #include "anyfin/perf_counters_win32.hpp"
+  #elif defined(PLATFORM_LINUX)
+    #include "anyfin/perf_counters_linux.hpp"
+  #else
+    #error "Unsupported platform"
+  #endif
+#endif
@@ -0,0 +1,125 @@
+
+#define FIN_PERF_COUNTERS_HPP_IMPL
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "anyfin/perf_counters.hpp"
+
+namespace Fin {
+
+static perf_event_attr make_counter_attributes (Perf_Counter counter) {
+  using enum Perf_Counter;
+
+  perf_event_attr attributes {};
+  attributes.size = sizeof(perf_event_attr);
+  attributes.type = PERF_TYPE_HARDWARE;
+
+  switch (counter) {
+    case Cycles:        attributes.config = PERF_COUNT_HW_CPU_CYCLES;       break;
+    case Instructions:  attributes.config = PERF_COUNT_HW_INSTRUCTIONS;     break;
+    case Cache_Misses:  attributes.config = PERF_COUNT_HW_CACHE_MISSES;     break;
+    case Branch_Misses: attributes.config = PERF_COUNT_HW_BRANCH_MISSES;    break;
+    case TLB_Misses: {
+      attributes.type   = PERF_TYPE_HW_CACHE;
+      attributes.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    }
+  }
+
+  // Excluding the kernel is what unprivileged processes are allowed with the default paranoia level of 2.
+  attributes.exclude_kernel = 1;
+  attributes.exclude_hv     = 1;
+  attributes.read_format    = u64(PERF_FORMAT_GROUP) | u64(PERF_FORMAT_ID) | u64(PERF_FORMAT_TOTAL_TIME_ENABLED) | u64(PERF_FORMAT_TOTAL_TIME_RUNNING);
+
+  return attributes;
+}
+
+static Sys_Result<Perf_Counter_Group> open_perf_counters () {
+  Perf_Counter_Group group;
+
+  s32 leader = -1;
+  for (u32 idx = 0; idx < perf_counters_count; idx++) {
+    auto attributes = make_counter_attributes(static_cast<Perf_Counter>(idx));
+
+    // The group is started by enabling its leader, the rest follow it.
+    attributes.disabled = (leader < 0);
+
+    auto descriptor = static_cast<s32>(syscall(SYS_perf_event_open, &attributes, 0, -1, leader, PERF_FLAG_FD_CLOEXEC));
+    if (descriptor < 0) continue;
+
+    if (leader < 0) leader = descriptor;
+
+    group.descriptors[idx]  = descriptor;
+    group.available_mask   |= 1u << idx;
+  }
+
+  if (leader < 0) return get_system_error();
+
+  if (ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0) {
+    auto error = get_system_error();
+    close_perf_counters(group);
+    return error;
+  }
+
+  return group;
+}
+
+static Sys_Result<void> close_perf_counters (Perf_Counter_Group &group) {
+  bool has_failed = false;
+  for (auto &descriptor: group.descriptors) {
+    if (descriptor >= 0) has_failed |= (close(descriptor) != 0);
+    descriptor = -1;
+  }
+
+  group.available_mask = 0;
+
+  if (has_failed) return get_system_error();
+
+  return Ok();
+}
+
+static Perf_Counter_Values read_perf_counters (const Perf_Counter_Group &group) {
+  Perf_Counter_Values result;
+  if (!group.available_mask) return result;
+
+  s32 leader = -1;
+  for (auto descriptor: group.descriptors) {
+    if (descriptor >= 0) {
+      leader = descriptor;
+      break;
+    }
+  }
+
+  /*
+    Group read layout: count, time enabled, time running, then (value, id) for each member in the order they
+    were added to the group.
+   */
+  struct {
+    u64 count;
+    u64 time_enabled;
+    u64 time_running;
+    struct { u64 value; u64 id; } members[perf_counters_count];
+  } data;
+
+  if (read(leader, &data, sizeof(data)) <= 0 || data.time_running == 0) return result;
+
+  result.available_mask = group.available_mask;
+
+  usize member = 0;
+  for (u32 idx = 0; idx < perf_counters_count && member < data.count; idx++) {
+    if (!(group.available_mask & (1u << idx))) continue;
+
+    auto value = data.members[member++].value;
+    if (data.time_running < data.time_enabled)
+      value = static_cast<u64>(static_cast<double>(value) * data.time_enabled / data.time_running);
+
+    result.values[idx] = value;
+  }
+
+  return result;
+}
+
+}
@@ -0,0 +1,27 @@
+
+#define FIN_PERF_COUNTERS_HPP_IMPL
+
+#include "anyfin/win32.hpp"
+
+#include "anyfin/perf_counters.hpp"
+
+namespace Fin {
+
+/*
+  Windows exposes hardware counters only through ETW with administrative rights, which doesn't fit a per-thread
+  in-process API. Counters are reported as unavailable, and the callers carry on without them.
+ */
+static Sys_Result<Perf_Counter_Group> open_perf_counters () {
+  return System_Error { "hardware performance counters aren't supported on this platform", ERROR_NOT_SUPPORTED };
+}
+
+static Sys_Result<void> close_perf_counters (Perf_Counter_Group &group) {
+  group = Perf_Counter_Group {};
+  return Ok();
+}
+
+static Perf_Counter_Values read_perf_counters (const Perf_Counter_Group &group) {
+  return Perf_Counter_Values {};
+}
+
+}
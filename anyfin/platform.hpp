@@ -13,10 +13,12 @@ namespace Fin {
 
 enum struct Platform {
   Win32,
+  Linux,
 };
 
 static Platform get_platform_type ();
 static bool is_win32 () { return get_platform_type() == Platform::Win32; }
+static bool is_linux () { return get_platform_type() == Platform::Linux; }
 
 struct System_Error {
   String details;
@@ -45,8 +47,7 @@ static auto to_string (const System_Error &error, Memory_Arena &arena) {
     copy_memory(buffer, msg, msg_len);
   }
   
-  auto code_str = to_string(error.error_code, arena);
-  if (code_str.length) [[likely]] arena.offset -= 1; // remove the terminating zero after rendering the numeric code
+  write_integer(arena, error.error_code);
 
   {
     auto buffer = reserve<char>(arena, 3);
@@ -73,6 +74,8 @@ static auto to_string (const System_Error &error, Memory_Arena &arena) {
 #ifndef FIN_PLATFORM_HPP_IMPL
   #ifdef PLATFORM_WIN32
     #include "anyfin/platform_win32.hpp"
+  #elif defined(PLATFORM_LINUX)
+    #include "anyfin/platform_linux.hpp"
   #else
     #error "Unsupported platform"
   #endif
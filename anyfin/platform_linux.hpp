@@ -0,0 +1,43 @@
+
+#define FIN_PLATFORM_HPP_IMPL
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "anyfin/strings.hpp"
+#include "anyfin/platform.hpp"
+
+namespace Fin {
+
+static Platform get_platform_type () { return Platform::Linux; }
+
+static u32 get_system_error_code () {
+  return errno;
+}
+
+/*
+  Unlike FormatMessage on Windows, strerror doesn't support message inserts, thus the arguments are
+  accepted for API compatibility only. The returned string is owned by libc and must not be freed.
+ */
+static System_Error get_system_error (Convertible_To<const char *> auto&&... args) {
+  auto error_code = get_system_error_code();
+  return System_Error { String(strerror(error_code)), error_code };
+}
+
+static void destroy (System_Error error) {}
+
+static u32 get_logical_cpu_count () {
+  auto count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? static_cast<u32>(count) : 1;
+}
+
+static Sys_Result<Option<String>> get_env_var (Memory_Arena &arena, String name) {
+  auto value = getenv(name);
+  if (!value) return Option<String>(opt_none);
+
+  return Option(copy_string(arena, value));
+}
+
+}
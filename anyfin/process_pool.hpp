@@ -0,0 +1,71 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/arena.hpp"
+#include "anyfin/commands.hpp"
+#include "anyfin/jobserver.hpp"
+#include "anyfin/list.hpp"
+#include "anyfin/platform.hpp"
+#include "anyfin/slice.hpp"
+
+namespace Fin {
+
+struct Command_Job {
+  Command command;
+
+  /*
+    Time the child is given to finish, after which it's killed. Zero means there's no limit.
+   */
+  u32 timeout_millis = 0;
+};
+
+enum struct Job_Status: u32 { Finished, Timed_Out, Failed_To_Start };
+
+struct Job_Completion {
+  usize      job_index; // Index of the job in the slice passed to run_jobs
+  Job_Status status;
+
+  /*
+    For jobs that timed out, this is the output produced before the child was killed.
+   */
+  Command_Output output;
+
+  /*
+    Set only for jobs that failed to start.
+   */
+  System_Error error;
+};
+
+/*
+  Run the jobs concurrently, keeping at most `slots_count` children alive at any moment, which defaults to the
+  number of logical cores. `on_completion` is called with each job's Job_Completion in the order jobs finish,
+  outputs are placed into the arena.
+
+  A job failing to start or running out of time doesn't stop the rest, the error is returned only when the
+  pool itself fails, in which case all running children are killed.
+
+  With an active jobserver, every job besides the first running one also needs a token, which limits the
+  concurrency across the whole process tree. Hosted jobserver's makeflags should be added to the jobs'
+  environment for make-aware children to join it.
+ */
+static Sys_Result<void> run_jobs (Memory_Arena &arena, Slice<Command_Job> jobs, u32 slots_count, const auto &on_completion, Jobserver *jobserver = nullptr);
+
+static Sys_Result<List<Job_Completion>> run_jobs (Memory_Arena &arena, Slice<Command_Job> jobs, u32 slots_count = 0, Jobserver *jobserver = nullptr) {
+  List<Job_Completion> completions { arena };
+
+  fin_check(run_jobs(arena, jobs, slots_count, [&] (Job_Completion &completion) {
+    list_push(completions, move(completion));
+  }, jobserver));
+
+  return Ok(move(completions));
+}
+
+}
+
+#ifndef FIN_PROCESS_POOL_HPP_IMPL
+  #ifdef PLATFORM_LINUX
+    #include "anyfin/process_pool_linux.hpp"
+  #else
+    #error "Unsupported platform"
+  #endif
+#endif
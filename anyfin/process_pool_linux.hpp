@@ -0,0 +1,340 @@
+
+#define FIN_PROCESS_POOL_HPP_IMPL
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "anyfin/arena.hpp"
+#include "anyfin/array.hpp"
+#include "anyfin/commands.hpp"
+#include "anyfin/defer.hpp"
+#include "anyfin/process_pool.hpp"
+
+namespace Fin {
+
+/*
+  Each running child occupies a slot, whose pipes and pidfd are registered with the same epoll instance. Events
+  carry the slot's index and which of its descriptors is ready.
+ */
+struct Job_Slot {
+  enum struct Source: u64 { Output, Error, Exit };
+
+  usize         job_index;
+  Child_Process child;
+  int           exit_descriptor; // pidfd, -1 once the child has been reaped
+
+  Output_Capture output;
+  Output_Capture error;
+
+  u64  deadline; // CLOCK_MONOTONIC milliseconds, zero if the job has no timeout
+  bool timed_out;
+  u32  status_code;
+  bool active;
+
+  /*
+    Jobserver's token taken for this job, otherwise the job runs on the implicit token of this process.
+   */
+  bool holds_token;
+  char token;
+};
+
+constexpr u64 jobserver_event_tag = static_cast<u64>(-1);
+
+static u64 get_monotonic_millis () {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<u64>(now.tv_sec) * 1000 + static_cast<u64>(now.tv_nsec) / 1000000;
+}
+
+fin_forceinline
+static u64 make_event_tag (usize slot_index, Job_Slot::Source source) {
+  return (static_cast<u64>(slot_index) << 2) | static_cast<u64>(source);
+}
+
+static Sys_Result<void> watch_descriptor (int epoll, int descriptor, u64 tag) {
+  epoll_event event { .events = EPOLLIN, .data = { .u64 = tag } };
+  if (epoll_ctl(epoll, EPOLL_CTL_ADD, descriptor, &event) != 0) return get_system_error();
+  return Ok();
+}
+
+static Sys_Result<void> start_job (int epoll, Memory_Arena &arena, Job_Slot &slot, usize slot_index, usize job_index, const Command_Job &job) {
+  using enum Job_Slot::Source;
+
+  auto [spawn_error, child] = spawn_child_process(arena, job.command);
+  if (spawn_error) return move(spawn_error.value);
+
+  slot = Job_Slot {
+    .job_index       = job_index,
+    .child           = child,
+    .exit_descriptor = static_cast<int>(syscall(SYS_pidfd_open, child.id, 0)),
+    .deadline        = job.timeout_millis ? get_monotonic_millis() + job.timeout_millis : 0,
+    .active          = true,
+  };
+
+  const auto fail = [&] () -> System_Error {
+    auto error = get_system_error();
+
+    close_child_streams(slot.child);
+    if (slot.exit_descriptor >= 0) close(slot.exit_descriptor);
+
+    kill(slot.child.id, SIGKILL);
+    wait_for_child(slot.child);
+
+    slot.active = false;
+
+    return error;
+  };
+
+  if (slot.exit_descriptor < 0) return fail();
+
+  if (watch_descriptor(epoll, slot.exit_descriptor, make_event_tag(slot_index, Exit)).is_error()) return fail();
+  if (watch_descriptor(epoll, slot.child.output,    make_event_tag(slot_index, Output)).is_error()) return fail();
+  if (slot.child.error >= 0 && watch_descriptor(epoll, slot.child.error, make_event_tag(slot_index, Error)).is_error()) return fail();
+
+  return Ok();
+}
+
+/*
+  The pidfd is readable once the child has terminated, thus reaping it here doesn't block.
+ */
+static Sys_Result<void> reap_job (Job_Slot &slot) {
+  auto [wait_error, status_code] = wait_for_child(slot.child);
+  if (wait_error) return move(wait_error.value);
+
+  close(slot.exit_descriptor);
+  slot.exit_descriptor = -1;
+  slot.status_code     = status_code;
+
+  return Ok();
+}
+
+static void abandon_job (Job_Slot &slot) {
+  close_child_streams(slot.child);
+
+  if (slot.exit_descriptor >= 0) {
+    kill(slot.child.id, SIGKILL);
+    wait_for_child(slot.child);
+    close(slot.exit_descriptor);
+  }
+
+  destroy(slot.output);
+  destroy(slot.error);
+
+  slot.active = false;
+}
+
+static Sys_Result<void> run_jobs (Memory_Arena &arena, Slice<Command_Job> jobs, u32 slots_count, const auto &on_completion, Jobserver *jobserver) {
+  using enum Job_Slot::Source;
+
+  if (slots_count == 0) slots_count = get_logical_cpu_count();
+  if (slots_count > jobs.count) slots_count = jobs.count;
+  if (slots_count == 0) return Ok();
+
+  auto slots = reserve_array<Job_Slot>(arena, slots_count);
+  if (!slots.values) return System_Error { "not enough memory in the arena for the pool's slots", ENOMEM };
+  for (auto &slot: slots) slot.active = false;
+
+  auto epoll = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll < 0) return get_system_error();
+
+  if (jobserver && !is_active(*jobserver)) jobserver = nullptr;
+
+  /*
+    Jobserver's pipe is watched only while a job is waiting for a token, it stays readable as long as there
+    are spare tokens, which would otherwise wake the loop up constantly.
+   */
+  bool is_waiting_for_token = false;
+  if (jobserver) {
+    epoll_event event { .events = 0, .data = { .u64 = jobserver_event_tag } };
+    if (epoll_ctl(epoll, EPOLL_CTL_ADD, jobserver->read_descriptor, &event) != 0) {
+      auto error = get_system_error();
+      close(epoll);
+      return error;
+    }
+  }
+
+  bool is_implicit_token_used = false;
+
+  const auto release_job_token = [&] (Job_Slot &slot) -> Sys_Result<void> {
+    if (!jobserver) return Ok();
+
+    if (!slot.holds_token) {
+      is_implicit_token_used = false;
+      return Ok();
+    }
+
+    slot.holds_token = false;
+
+    return release_token(*jobserver, slot.token);
+  };
+
+  defer {
+    for (auto &slot: slots) {
+      if (!slot.active) continue;
+
+      abandon_job(slot);
+      release_job_token(slot);
+    }
+
+    close(epoll);
+  };
+
+  const auto complete_job = [&] (Job_Slot &slot) -> Sys_Result<void> {
+    auto standard_output = copy_string(arena, String(reinterpret_cast<char *>(slot.output.memory), slot.output.size));
+    auto error_output    = copy_string(arena, String(reinterpret_cast<char *>(slot.error.memory),  slot.error.size));
+
+    destroy(slot.output);
+    destroy(slot.error);
+    slot.active = false;
+
+    // The child is reaped already, thus the slot is released before failing, not abandoned with the running ones.
+    if (!standard_output.value || !error_output.value) {
+      fin_check(release_job_token(slot));
+      return System_Error { "not enough memory in the arena for the job's output", ENOMEM };
+    }
+
+    Job_Completion completion {
+      .job_index = slot.job_index,
+      .status    = slot.timed_out ? Job_Status::Timed_Out : Job_Status::Finished,
+      .output    = Command_Output {
+        .standard_output = standard_output,
+        .error_output    = error_output,
+        .status_code     = slot.status_code,
+      },
+    };
+
+    on_completion(completion);
+
+    return release_job_token(slot);
+  };
+
+  usize next_job      = 0;
+  usize running_count = 0;
+
+  while (next_job < jobs.count || running_count > 0) {
+    for (usize idx = 0; idx < slots.count && next_job < jobs.count;) {
+      if (slots[idx].active) {
+        idx += 1;
+        continue;
+      }
+
+      bool holds_token = false;
+      char token       = 0;
+
+      if (jobserver && is_implicit_token_used) {
+        auto [token_error, acquired] = try_acquire_token(*jobserver, token);
+        if (token_error) return move(token_error.value);
+
+        is_waiting_for_token = !acquired;
+        if (!acquired) break;
+
+        holds_token = true;
+      }
+
+      if (jobserver && !holds_token) is_implicit_token_used = true;
+
+      auto job_index = next_job++;
+
+      auto result = start_job(epoll, arena, slots[idx], idx, job_index, jobs[job_index]);
+
+      slots[idx].holds_token = holds_token;
+      slots[idx].token       = token;
+
+      if (result.is_error()) {
+        Job_Completion completion {
+          .job_index = job_index,
+          .status    = Job_Status::Failed_To_Start,
+          .error     = move(result.error.value),
+        };
+
+        on_completion(completion);
+
+        fin_check(release_job_token(slots[idx]));
+
+        continue; // The slot is still free, trying it with the next job
+      }
+
+      running_count += 1;
+      idx           += 1;
+    }
+
+    if (jobserver) {
+      if (next_job == jobs.count || running_count == slots.count) is_waiting_for_token = false;
+
+      epoll_event event { .events = is_waiting_for_token ? EPOLLIN : 0u, .data = { .u64 = jobserver_event_tag } };
+      if (epoll_ctl(epoll, EPOLL_CTL_MOD, jobserver->read_descriptor, &event) != 0) return get_system_error();
+    }
+
+    if (running_count == 0) continue;
+
+    auto now = get_monotonic_millis();
+
+    int timeout = -1;
+    for (auto &slot: slots) {
+      if (!slot.active || !slot.deadline || slot.timed_out) continue;
+
+      auto remaining = slot.deadline > now ? static_cast<int>(slot.deadline - now) : 0;
+      if (timeout < 0 || remaining < timeout) timeout = remaining;
+    }
+
+    epoll_event events[64];
+    auto events_count = epoll_wait(epoll, events, 64, timeout);
+    if (events_count < 0) {
+      if (errno == EINTR) continue;
+      return get_system_error();
+    }
+
+    for (int idx = 0; idx < events_count; idx++) {
+      auto tag = events[idx].data.u64;
+      if (tag == jobserver_event_tag) continue; // Tokens are taken when starting jobs at the next iteration
+
+      auto &slot   = slots[tag >> 2];
+      auto  source = static_cast<Job_Slot::Source>(tag & 3);
+
+      if (!slot.active) continue;
+
+      switch (source) {
+        case Output: {
+          if (slot.child.output >= 0) fin_check(read_into_capture(slot.output, slot.child.output));
+          break;
+        }
+        case Error: {
+          if (slot.child.error >= 0) fin_check(read_into_capture(slot.error, slot.child.error));
+          break;
+        }
+        case Exit: {
+          if (slot.exit_descriptor >= 0) fin_check(reap_job(slot));
+          break;
+        }
+      }
+
+      // Exit and end of both streams may be reported in any order, the job is complete once all have been seen.
+      if (slot.exit_descriptor < 0 && slot.child.output < 0 && slot.child.error < 0) {
+        running_count -= 1;
+        fin_check(complete_job(slot));
+      }
+    }
+
+    /*
+      Children that ran out of time are killed, their pipes closed right away, since the child's own children
+      could keep them open indefinitely. The job completes once the pidfd reports the child's termination.
+     */
+    now = get_monotonic_millis();
+    for (auto &slot: slots) {
+      if (!slot.active || !slot.deadline || slot.timed_out || now < slot.deadline) continue;
+
+      slot.timed_out = true;
+
+      kill(slot.child.id, SIGKILL);
+      close_child_streams(slot.child);
+    }
+  }
+
+  return Ok();
+}
+
+}
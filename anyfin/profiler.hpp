@@ -0,0 +1,253 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/arena.hpp"
+#include "anyfin/atomics.hpp"
+#include "anyfin/callsite.hpp"
+#include "anyfin/concurrent.hpp"
+#include "anyfin/memory.hpp"
+#include "anyfin/perf_counters.hpp"
+#include "anyfin/threads.hpp"
+#include "anyfin/timers.hpp"
+
+/*
+  Instrumentation of the code with zones, instant events and counters, which is cheap enough to be left on in
+  production builds: recording an event is two timer reads and a store into the thread's own ring buffer,
+  without locks or allocations. Threads that haven't been registered with register_profiler_thread don't
+  record anything. Defining FIN_DISABLE_PROFILER compiles the instrumentation out.
+
+    void compile_file (File_Path path) {
+      profile_zone("compile_file");
+      ...
+    }
+
+  profile_zone_counters additionally records the deltas of the thread's hardware counters over the zone as
+  counter events named after the zone ("compile_file.instructions", ...). Reading the counters is a syscall,
+  so these zones are for coarse-grained parts of the work.
+ */
+#ifndef FIN_DISABLE_PROFILER
+  #define profile_zone(NAME)            fin_profile_zone(NAME, __COUNTER__)
+  #define profile_instant(NAME)         fin_profile_event(NAME, Instant, 0, __COUNTER__)
+  #define profile_counter(NAME, VALUE)  fin_profile_event(NAME, Counter, VALUE, __COUNTER__)
+
+  #define profile_zone_counters(NAME, GROUP) fin_profile_zone_counters(NAME, GROUP, __COUNTER__)
+#else
+  #define profile_zone(NAME)
+  #define profile_zone_counters(NAME, GROUP)
+  #define profile_instant(NAME)
+  #define profile_counter(NAME, VALUE)
+#endif
+
+#define fin_profile_site(NAME, KIND, ID) \
+  static constexpr Fin::Profile_Site tokenpaste(__profile_site, ID) { NAME, Fin::Profile_Event_Kind::KIND, Fin::Callsite() }
+
+#define fin_profile_zone(NAME, ID)                                      \
+  fin_profile_site(NAME, Zone, ID);                                     \
+  Fin::Profile_Zone tokenpaste(__profile_zone, ID) { &tokenpaste(__profile_site, ID) }
+
+#define fin_profile_zone_counters(NAME, GROUP, ID)                      \
+  fin_profile_site(NAME, Zone, ID);                                     \
+  static constexpr Fin::Profile_Site tokenpaste(__profile_counter_sites, ID)[] { \
+    { NAME ".cycles",        Fin::Profile_Event_Kind::Counter, Fin::Callsite() }, \
+    { NAME ".instructions",  Fin::Profile_Event_Kind::Counter, Fin::Callsite() }, \
+    { NAME ".cache_misses",  Fin::Profile_Event_Kind::Counter, Fin::Callsite() }, \
+    { NAME ".branch_misses", Fin::Profile_Event_Kind::Counter, Fin::Callsite() }, \
+    { NAME ".tlb_misses",    Fin::Profile_Event_Kind::Counter, Fin::Callsite() }, \
+  };                                                                    \
+  Fin::Profile_Counters_Zone tokenpaste(__profile_zone, ID) { &tokenpaste(__profile_site, ID), tokenpaste(__profile_counter_sites, ID), GROUP }
+
+#define fin_profile_event(NAME, KIND, VALUE, ID)                        \
+  do {                                                                  \
+    fin_profile_site(NAME, KIND, ID);                                   \
+    auto timestamp = Fin::get_timer_value();                            \
+    Fin::record_profile_event(&tokenpaste(__profile_site, ID), timestamp, static_cast<::u64>(VALUE)); \
+  } while (0)
+
+namespace Fin {
+
+enum struct Profile_Event_Kind: u32 { Zone, Instant, Counter };
+
+/*
+  Static description of the instrumented place in the code, events refer to it by pointer.
+ */
+struct Profile_Site {
+  const char         *name;
+  Profile_Event_Kind  kind;
+  Callsite            callsite;
+};
+
+/*
+  Timestamps are timer values, see get_timer_frequency for their conversion. For zones `value` is the timestamp
+  of the zone's end, for counters it's the counter's value.
+ */
+struct Profile_Event {
+  const Profile_Site *site;
+  u64                 timestamp;
+  u64                 value;
+};
+
+/*
+  Single-producer single-consumer ring of the thread's events. The owning thread is the only writer, the
+  collector is the only reader, indices only grow and are wrapped on access. When the ring is full, new events
+  are dropped and counted rather than waiting for the collector.
+ */
+struct Profile_Buffer {
+  Profile_Event *events;
+  usize          capacity; // Power of two
+
+  u32 thread_id;
+
+  cau64 write_index;
+  cau64 read_index;
+
+  /*
+    Producer's copy of the read index, refreshed only when the ring looks full, so that the hot path doesn't
+    touch the collector's cache line.
+   */
+  u64 cached_read_index;
+  au64 dropped_count;
+
+  abool           is_retired; // Set once the thread has unregistered, no events are recorded afterwards
+  Profile_Buffer *next;
+};
+
+// Buffers of all registered threads, retired ones are unlinked by the collector.
+static Registered_List<Profile_Buffer> profile_buffers;
+
+static thread_local Profile_Buffer *current_profile_buffer = nullptr;
+
+/*
+  Register the calling thread with the profiler, allocating its ring of `events_capacity` events (rounded up to
+  a power of two) from the arena, which must outlive the profiler's use, since the collector keeps reading the
+  buffer after the thread has unregistered, until the remaining events are drained.
+ */
+static bool register_profiler_thread (Memory_Arena &arena, usize events_capacity = 1 << 16) {
+  if (current_profile_buffer) return true;
+
+  usize capacity = 1;
+  while (capacity < events_capacity) capacity <<= 1;
+
+  auto buffer = reserve<Profile_Buffer>(arena, sizeof(Profile_Buffer), alignof(Profile_Buffer));
+  auto events = reserve<Profile_Event>(arena, sizeof(Profile_Event) * capacity, CACHE_LINE_SIZE);
+  if (!buffer || !events) return false;
+
+  zero_memory(buffer);
+
+  buffer->events    = events;
+  buffer->capacity  = capacity;
+  buffer->thread_id = get_current_thread_id();
+
+  // Otherwise the first zone recorded on the thread could end up paying for the timer's calibration.
+  calibrate_timer();
+
+  register_node(profile_buffers, buffer);
+
+  current_profile_buffer = buffer;
+
+  return true;
+}
+
+/*
+  Stop recording events on the calling thread. Events already recorded are still delivered to the collector,
+  which unlinks the buffer afterwards.
+ */
+static void unregister_profiler_thread () {
+  auto buffer = current_profile_buffer;
+  if (!buffer) return;
+
+  atomic_store<Memory_Order::Release>(buffer->is_retired, true);
+  current_profile_buffer = nullptr;
+}
+
+fin_forceinline
+static void record_profile_event (const Profile_Site *site, u64 timestamp, u64 value) {
+  auto buffer = current_profile_buffer;
+  if (!buffer) return;
+
+  auto write_index = atomic_load(buffer->write_index);
+  if (write_index - buffer->cached_read_index == buffer->capacity) [[unlikely]] {
+    buffer->cached_read_index = atomic_load<Memory_Order::Acquire>(buffer->read_index);
+
+    if (write_index - buffer->cached_read_index == buffer->capacity) {
+      atomic_store(buffer->dropped_count, atomic_load(buffer->dropped_count) + 1);
+      return;
+    }
+  }
+
+  buffer->events[write_index & (buffer->capacity - 1)] = Profile_Event { site, timestamp, value };
+  atomic_store<Memory_Order::Release>(buffer->write_index, write_index + 1);
+}
+
+struct Profile_Zone {
+  const Profile_Site *site;
+  u64                 start;
+
+  fin_forceinline
+  Profile_Zone (const Profile_Site *_site)
+    : site { _site }, start { get_timer_value() } {}
+
+  fin_forceinline
+  ~Profile_Zone () {
+    record_profile_event(site, start, get_timer_value());
+  }
+
+  Profile_Zone (const Profile_Zone &) = delete;
+};
+
+struct Profile_Counters_Zone {
+  const Profile_Site       *site;
+  const Profile_Site       *counter_sites; // One per counter, in the order of Perf_Counter
+  const Perf_Counter_Group &group;
+  Perf_Counter_Values       counters;
+  u64                       start;
+
+  Profile_Counters_Zone (const Profile_Site *_site, const Profile_Site *_counter_sites, const Perf_Counter_Group &_group)
+    : site { _site }, counter_sites { _counter_sites }, group { _group }
+  {
+    // Nothing is recorded by unregistered threads, so there's no need to pay for the counters' read.
+    if (current_profile_buffer) counters = read_perf_counters(group);
+    start = get_timer_value();
+  }
+
+  ~Profile_Counters_Zone () {
+    auto end = get_timer_value();
+    record_profile_event(site, start, end);
+
+    if (!current_profile_buffer || !counters.available_mask) return;
+
+    auto deltas = get_counter_deltas(counters, read_perf_counters(group));
+    for (u32 idx = 0; idx < perf_counters_count; idx++) {
+      if (deltas.available_mask & (1u << idx)) record_profile_event(counter_sites + idx, end, deltas.values[idx]);
+    }
+  }
+
+  Profile_Counters_Zone (const Profile_Counters_Zone &) = delete;
+};
+
+/*
+  Hand all recorded events over to `on_event(const Profile_Buffer &, const Profile_Event &)`, freeing the space
+  in the threads' rings. Events of each thread are delivered in the order they were recorded, which for zones
+  is the order of their ends. There must be a single collector at a time.
+
+  Returns the number of delivered events.
+ */
+static usize drain_profile_events (const auto &on_event) {
+  usize delivered = 0;
+
+  visit_registered_nodes(profile_buffers, [&] (Profile_Buffer &buffer) {
+    auto read_index  = atomic_load(buffer.read_index);
+    auto write_index = atomic_load<Memory_Order::Acquire>(buffer.write_index);
+
+    for (auto idx = read_index; idx < write_index; idx++) {
+      on_event(buffer, buffer.events[idx & (buffer.capacity - 1)]);
+    }
+
+    atomic_store<Memory_Order::Release>(buffer.read_index, write_index);
+
+    delivered += write_index - read_index;
+  });
+
+  return delivered;
+}
+
+}
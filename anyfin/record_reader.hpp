@@ -0,0 +1,125 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/arena.hpp"
+#include "anyfin/file_system.hpp"
+#include "anyfin/memory.hpp"
+#include "anyfin/option.hpp"
+#include "anyfin/prelude.hpp"
+#include "anyfin/strings.hpp"
+
+namespace Fin {
+
+/*
+  Streaming reader that splits the content of a file, pipe or the standard input into records separated by
+  the delimiter, using a fixed buffer regardless of the stream's size.
+
+  Records are returned as views into the reader's buffer and stay valid only until the next call. When the
+  buffer is exhausted, the unconsumed tail is moved to the front and the rest is refilled from the stream.
+  Records that don't fit into the buffer are returned in buffer-sized pieces.
+ */
+struct Record_Reader {
+  File *file;
+
+  char  *buffer;
+  usize  capacity;
+
+  usize start   = 0; // Beginning of the unconsumed data
+  usize end     = 0; // End of the data read from the stream
+  usize scanned = 0; // Data in [start, scanned) is known not to contain the delimiter
+
+  char delimiter;
+  bool end_of_stream = false;
+
+  Record_Reader (File &_file, Memory_Arena &arena, usize buffer_size = kilobytes(64), char _delimiter = '\n')
+    : file      { &_file },
+      buffer    { reserve<char>(arena, buffer_size) },
+      capacity  { buffer_size },
+      delimiter { _delimiter }
+  {
+    fin_ensure(buffer);
+    fin_ensure(capacity > 0);
+  }
+};
+
+/*
+  Returns the next record without the delimiter, or none once the stream has been fully consumed.
+ */
+static Sys_Result<Option<String>> read_next_record (Record_Reader &reader) {
+  while (true) {
+    if (reader.scanned < reader.end) {
+      auto search_start = reader.buffer + reader.scanned;
+      auto position     = get_character_offset(search_start, reader.end - reader.scanned, reader.delimiter);
+
+      if (position) {
+        auto record = String(reader.buffer + reader.start, position - (reader.buffer + reader.start));
+
+        reader.start   = (position - reader.buffer) + 1;
+        reader.scanned = reader.start;
+
+        return Option(move(record));
+      }
+
+      reader.scanned = reader.end;
+    }
+
+    if (reader.end_of_stream) {
+      if (reader.start == reader.end) return Option<String>(opt_none);
+
+      auto record = String(reader.buffer + reader.start, reader.end - reader.start);
+      reader.start = reader.end;
+
+      return Option(move(record));
+    }
+
+    if (reader.start > 0) {
+      auto pending = reader.end - reader.start;
+      move_memory(reader.buffer, reader.buffer + reader.start, pending);
+
+      reader.start    = 0;
+      reader.end      = pending;
+      reader.scanned  = pending;
+    }
+
+    if (reader.end == reader.capacity) {
+      auto record = String(reader.buffer, reader.end);
+
+      reader.start   = reader.end;
+      reader.scanned = reader.end;
+
+      return Option(move(record));
+    }
+
+    auto [error, bytes_read] = read_available_bytes(*reader.file, cast_bytes<u8>(reader.buffer + reader.end), reader.capacity - reader.end);
+    if (error) return move(error.value);
+
+    if (bytes_read == 0) reader.end_of_stream = true;
+    reader.end += bytes_read;
+  }
+}
+
+/*
+  Same as read_next_record, but also drops the carriage return preceding the new line, if there's one.
+ */
+static Sys_Result<Option<String>> read_next_line (Record_Reader &reader) {
+  fin_ensure(reader.delimiter == '\n');
+
+  auto [error, line] = read_next_record(reader);
+  if (error) return move(error.value);
+
+  if (line && ends_with(line.value, "\r")) line.value.length -= 1;
+
+  return move(line);
+}
+
+static Sys_Result<void> for_each_record (Record_Reader &reader, const Invocable<bool, String> auto &func) {
+  while (true) {
+    auto [error, record] = read_next_record(reader);
+    if (error)   return move(error.value);
+    if (!record) return Ok();
+
+    if (!func(record.value)) return Ok();
+  }
+}
+
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/arena.hpp"
+#include "anyfin/array.hpp"
+#include "anyfin/atomics.hpp"
+#include "anyfin/buffered_writer.hpp"
+#include "anyfin/concurrent.hpp"
+#include "anyfin/memory.hpp"
+#include "anyfin/platform.hpp"
+#include "anyfin/slice.hpp"
+#include "anyfin/sort.hpp"
+#include "anyfin/strings.hpp"
+
+/*
+  Statistical CPU profiler that doesn't need any instrumentation. Each registered thread gets a timer ticking
+  with the thread's CPU time, on every tick the signal handler walks the thread's stack using frame pointers and
+  stores the return addresses into the thread's ring. Nothing is allocated or locked in the handler.
+
+  Stacks are walked through the frame pointer chain, thus the code must be compiled with -fno-omit-frame-pointer
+  for the frames to be complete, otherwise stacks are cut at the first function without a frame. Addresses are
+  symbolized offline: folded stacks refer to code as "module+0xoffset", which addr2line resolves given the same
+  binaries.
+
+    start_sampling_profiler();
+    register_sampling_thread(arena);
+    ...
+    write_folded_stacks(writer, arena);
+ */
+
+namespace Fin {
+
+constexpr usize max_sampled_frames = 62;
+
+struct Stack_Sample {
+  u32   thread_id;
+  u32   frames_count;
+
+  /*
+    The interrupted instruction first, followed by the return addresses up the call chain.
+   */
+  usize frames[max_sampled_frames];
+};
+
+/*
+  Single-producer ring of the thread's samples, the producer is the signal handler running on the thread.
+ */
+struct Sample_Buffer {
+  Stack_Sample *samples;
+  usize         capacity; // Power of two
+
+  u32 thread_id;
+
+  /*
+    Bounds of the thread's stack, frame pointers outside of them are never dereferenced.
+   */
+  usize stack_start;
+  usize stack_end;
+
+  cau64 write_index;
+  cau64 read_index;
+  au64  dropped_count;
+
+  abool          is_retired; // Set once the thread has unregistered, no samples are taken afterwards
+  Sample_Buffer *next;
+};
+
+// Buffers of all sampled threads, retired ones are unlinked by the collector.
+static Registered_List<Sample_Buffer> sample_buffers;
+
+static thread_local Sample_Buffer *current_sample_buffer = nullptr;
+
+/*
+  Executable mapping of a module in the process' address space.
+ */
+struct Module_Mapping {
+  usize  start;
+  usize  end;
+  usize  file_offset;
+  String path;
+};
+
+/*
+  Install the signal handler and set the sampling frequency, must be called before the threads are registered.
+  The default frequency is a prime number, so that sampling doesn't line up with periodic work.
+ */
+static Sys_Result<void> start_sampling_profiler (u32 frequency = 997);
+
+/*
+  Start sampling the calling thread, allocating its ring of `samples_capacity` samples (rounded up to a power of
+  two) from the arena, which must outlive the profiler's use, since the collector keeps reading the ring after
+  the thread has unregistered, until the remaining samples are drained. The thread's samples must be drained
+  often enough for the ring not to overflow, overflowing samples are dropped and counted.
+ */
+static Sys_Result<void> register_sampling_thread (Memory_Arena &arena, usize samples_capacity = 4096);
+
+/*
+  Stop sampling the calling thread. Samples already taken are still delivered to the collector, which unlinks
+  the buffer afterwards.
+ */
+static Sys_Result<void> unregister_sampling_thread ();
+
+/*
+  Executable mappings of the process, ordered by their addresses, placed in the arena.
+ */
+static Sys_Result<Array<Module_Mapping>> load_module_mappings (Memory_Arena &arena);
+
+/*
+  Hand all taken samples over to `on_sample(const Sample_Buffer &, const Stack_Sample &)`, freeing the space in
+  the threads' rings. There must be a single collector at a time.
+
+  Returns the number of delivered samples.
+ */
+static usize drain_stack_samples (const auto &on_sample) {
+  usize delivered = 0;
+
+  visit_registered_nodes(sample_buffers, [&] (Sample_Buffer &buffer) {
+    auto read_index  = atomic_load(buffer.read_index);
+    auto write_index = atomic_load<Memory_Order::Acquire>(buffer.write_index);
+
+    for (auto idx = read_index; idx < write_index; idx++) {
+      on_sample(buffer, buffer.samples[idx & (buffer.capacity - 1)]);
+    }
+
+    atomic_store<Memory_Order::Release>(buffer.read_index, write_index);
+    delivered += write_index - read_index;
+  });
+
+  return delivered;
+}
+
+static bool is_less_stack (const Stack_Sample &left, const Stack_Sample &right) {
+  auto count = left.frames_count < right.frames_count ? left.frames_count : right.frames_count;
+  for (u32 idx = 0; idx < count; idx++) {
+    if (left.frames[idx] != right.frames[idx]) return left.frames[idx] < right.frames[idx];
+  }
+
+  return left.frames_count < right.frames_count;
+}
+
+static bool is_same_stack (const Stack_Sample &left, const Stack_Sample &right) {
+  if (left.frames_count != right.frames_count) return false;
+
+  for (u32 idx = 0; idx < left.frames_count; idx++) {
+    if (left.frames[idx] != right.frames[idx]) return false;
+  }
+
+  return true;
+}
+
+static const Module_Mapping * find_module_mapping (Slice<Module_Mapping> mappings, usize address) {
+  usize low = 0, high = mappings.count;
+  while (low < high) {
+    auto middle = low + (high - low) / 2;
+
+    if      (address <  mappings[middle].start) high = middle;
+    else if (address >= mappings[middle].end)   low  = middle + 1;
+    else return &mappings[middle];
+  }
+
+  return nullptr;
+}
+
+static Sys_Result<void> write_stack_frame (Buffered_Writer &writer, Slice<Module_Mapping> mappings, usize address) {
+  char offset[24];
+
+  auto mapping = find_module_mapping(mappings, address);
+  if (!mapping) {
+    String frame[] { "0x", render_hex(offset, address) };
+    return buffered_write(writer, Slice(frame));
+  }
+
+  auto name = mapping->path;
+  if (auto separator = get_character_offset_reversed(name.value, name.length, '/')) {
+    name = String(separator + 1, name.value + name.length - separator - 1);
+  }
+
+  String frame[] { name, "+0x", render_hex(offset, address - mapping->start + mapping->file_offset) };
+  return buffered_write(writer, Slice(frame));
+}
+
+/*
+  Drain all samples and write them aggregated in the folded stacks format, consumed by flamegraph.pl, speedscope
+  and the like: one line per unique stack, frames from the root to the leaf separated by ';', followed by the
+  number of samples. Return addresses are adjusted to point into the call instruction, so that they symbolize to
+  the line of the call rather than the one after it.
+
+  Samples are copied into the arena for aggregation, those that don't fit are skipped.
+ */
+static Sys_Result<void> write_folded_stacks (Buffered_Writer &writer, Memory_Arena &arena) {
+  auto samples = get_memory_at_current_offset<Stack_Sample>(arena);
+  usize count = 0;
+
+  drain_stack_samples([&] (const Sample_Buffer &, const Stack_Sample &sample) {
+    auto copy = reserve<Stack_Sample>(arena);
+    if (!copy) return;
+
+    *copy = sample;
+    count += 1;
+  });
+
+  auto stacks = Slice(samples, count);
+  sort(stacks, is_less_stack);
+
+  auto [mappings_error, mappings] = load_module_mappings(arena);
+  if (mappings_error) return move(mappings_error.value);
+
+  for (usize first = 0; first < count;) {
+    auto last = first + 1;
+    while (last < count && is_same_stack(stacks[first], stacks[last])) last += 1;
+
+    auto &stack = stacks[first];
+    for (u32 idx = stack.frames_count; idx > 0; idx--) {
+      auto address = stack.frames[idx - 1];
+      if (idx > 1) address -= 1;
+
+      fin_check(write_stack_frame(writer, slice(mappings), address));
+      if (idx > 1) fin_check(buffered_write(writer, ";"));
+    }
+
+    char samples_count[24];
+    String suffix[] { " ", render_unsigned(samples_count, last - first), "\n" };
+    fin_check(buffered_write(writer, Slice(suffix)));
+
+    first = last;
+  }
+
+  return Ok();
+}
+
+}
+
+#ifndef FIN_SAMPLING_PROFILER_HPP_IMPL
+  #if defined(PLATFORM_LINUX) && defined(CPU_ARCH_X64)
+    #include "anyfin/sampling_profiler_linux.hpp"
+  #else
+    #error "Unsupported platform"
+  #endif
+#endif
@@ -0,0 +1,250 @@
+
+#define FIN_SAMPLING_PROFILER_HPP_IMPL
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "anyfin/threads.hpp"
+#include "anyfin/sampling_profiler.hpp"
+
+namespace Fin {
+
+static u64 sampling_interval_nanos = 0;
+
+static thread_local timer_t current_sampling_timer;
+
+/*
+  Runs on the sampled thread, interrupting it at an arbitrary instruction, thus only async-signal-safe things
+  are allowed here: no allocations, no locks, no libc calls that could touch errno.
+ */
+static void take_stack_sample (int, siginfo_t *, void *context) {
+  auto buffer = current_sample_buffer;
+  if (!buffer) return;
+
+  auto write_index = atomic_load(buffer->write_index);
+  if (write_index - atomic_load<Memory_Order::Acquire>(buffer->read_index) == buffer->capacity) {
+    atomic_store(buffer->dropped_count, atomic_load(buffer->dropped_count) + 1);
+    return;
+  }
+
+  auto &sample    = buffer->samples[write_index & (buffer->capacity - 1)];
+  auto &registers = static_cast<ucontext_t *>(context)->uc_mcontext.gregs;
+
+  auto stack_pointer = static_cast<usize>(registers[REG_RSP]);
+  auto frame         = static_cast<usize>(registers[REG_RBP]);
+
+  sample.thread_id    = buffer->thread_id;
+  sample.frames[0]    = static_cast<usize>(registers[REG_RIP]);
+  sample.frames_count = 1;
+
+  /*
+    Each frame starts with the caller's frame pointer followed by the return address. The chain is trusted only
+    while it stays within the thread's stack and keeps growing towards its base, since code compiled without
+    frame pointers uses rbp as a general purpose register.
+   */
+  auto lower_bound = stack_pointer > buffer->stack_start ? stack_pointer : buffer->stack_start;
+  while (sample.frames_count < max_sampled_frames) {
+    if (frame < lower_bound || frame + 2 * sizeof(usize) > buffer->stack_end || frame % sizeof(usize)) break;
+
+    auto record         = reinterpret_cast<const usize *>(frame);
+    auto return_address = record[1];
+    if (!return_address) break;
+
+    sample.frames[sample.frames_count++] = return_address;
+
+    lower_bound = frame + 2 * sizeof(usize);
+    frame       = record[0];
+  }
+
+  atomic_store<Memory_Order::Release>(buffer->write_index, write_index + 1);
+}
+
+static Sys_Result<void> start_sampling_profiler (u32 frequency) {
+  fin_ensure(frequency > 0);
+
+  struct sigaction action {};
+  action.sa_sigaction = take_stack_sample;
+  action.sa_flags     = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+
+  if (sigaction(SIGPROF, &action, nullptr) != 0) return get_system_error();
+
+  sampling_interval_nanos = 1'000'000'000ull / frequency;
+
+  return Ok();
+}
+
+static Sys_Result<void> register_sampling_thread (Memory_Arena &arena, usize samples_capacity) {
+  if (current_sample_buffer) return Ok();
+
+  if (!sampling_interval_nanos) return System_Error { "sampling profiler must be started before registering threads", EINVAL };
+
+  usize capacity = 1;
+  while (capacity < samples_capacity) capacity <<= 1;
+
+  auto buffer  = reserve<Sample_Buffer>(arena, sizeof(Sample_Buffer), alignof(Sample_Buffer));
+  auto samples = reserve<Stack_Sample>(arena, sizeof(Stack_Sample) * capacity, CACHE_LINE_SIZE);
+  if (!buffer || !samples) return System_Error { "not enough memory in the arena for the samples ring", ENOMEM };
+
+  zero_memory(buffer);
+
+  pthread_attr_t attributes;
+  if (auto error_code = pthread_getattr_np(pthread_self(), &attributes)) return System_Error { String(strerror(error_code)), static_cast<u32>(error_code) };
+
+  void *stack_address = nullptr;
+  usize stack_size    = 0;
+  auto  error_code    = pthread_attr_getstack(&attributes, &stack_address, &stack_size);
+  pthread_attr_destroy(&attributes);
+
+  if (error_code) return System_Error { String(strerror(error_code)), static_cast<u32>(error_code) };
+
+  buffer->samples     = samples;
+  buffer->capacity    = capacity;
+  buffer->thread_id   = get_current_thread_id();
+  buffer->stack_start = reinterpret_cast<usize>(stack_address);
+  buffer->stack_end   = reinterpret_cast<usize>(stack_address) + stack_size;
+
+  /*
+    The timer follows the thread's own CPU time and signals this very thread, thus idle threads aren't sampled
+    and the handler always writes into the ring of the thread it runs on.
+   */
+  sigevent event {};
+  event.sigev_notify   = SIGEV_THREAD_ID;
+  event.sigev_signo    = SIGPROF;
+  event._sigev_un._tid = static_cast<pid_t>(buffer->thread_id); // sigev_notify_thread_id is missing in older glibc
+
+  timer_t timer;
+  if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer) != 0) return get_system_error();
+
+  register_node(sample_buffers, buffer);
+
+  current_sample_buffer  = buffer;
+  current_sampling_timer = timer;
+
+  itimerspec interval {};
+  interval.it_interval.tv_sec  = static_cast<time_t>(sampling_interval_nanos / 1'000'000'000);
+  interval.it_interval.tv_nsec = static_cast<long>(sampling_interval_nanos % 1'000'000'000);
+  interval.it_value            = interval.it_interval;
+
+  if (timer_settime(timer, 0, &interval, nullptr) != 0) return get_system_error();
+
+  return Ok();
+}
+
+static Sys_Result<void> unregister_sampling_thread () {
+  auto buffer = current_sample_buffer;
+  if (!buffer) return Ok();
+
+  // Once the timer is deleted no further signals are queued for it, a pending one finds the buffer cleared.
+  auto status = timer_delete(current_sampling_timer);
+
+  current_sample_buffer = nullptr;
+  atomic_store<Memory_Order::Release>(buffer->is_retired, true);
+
+  if (status != 0) return get_system_error();
+
+  return Ok();
+}
+
+static bool parse_hex (const char *&cursor, const char *end, usize &value) {
+  value = 0;
+
+  auto start = cursor;
+  for (; cursor < end; cursor++) {
+    auto symbol = *cursor;
+
+    usize digit;
+    if      (symbol >= '0' && symbol <= '9') digit = static_cast<usize>(symbol - '0');
+    else if (symbol >= 'a' && symbol <= 'f') digit = static_cast<usize>(symbol - 'a' + 10);
+    else break;
+
+    value = (value << 4) | digit;
+  }
+
+  return cursor != start;
+}
+
+static const char * skip_field (const char *cursor, const char *end) {
+  while (cursor < end && *cursor != ' ')  cursor++;
+  while (cursor < end && *cursor == ' ')  cursor++;
+  return cursor;
+}
+
+static Sys_Result<Array<Module_Mapping>> load_module_mappings (Memory_Arena &arena) {
+  auto descriptor = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+  if (descriptor < 0) return get_system_error();
+
+  /*
+    Proc files report zero size, thus the content is read until the end into the arena's free space.
+   */
+  auto content  = get_memory_at_current_offset<char>(arena);
+  auto capacity = get_remaining_size(arena);
+
+  usize size = 0;
+  while (size < capacity) {
+    auto bytes_read = read(descriptor, content + size, capacity - size);
+    if (bytes_read < 0) {
+      if (errno == EINTR) continue;
+
+      auto error = get_system_error();
+      close(descriptor);
+      return error;
+    }
+
+    if (bytes_read == 0) break;
+    size += static_cast<usize>(bytes_read);
+  }
+
+  close(descriptor);
+
+  if (size == capacity) return System_Error { "not enough memory in the arena for the process' mappings", ENOMEM };
+
+  /*
+    Lines have the format "start-end perms offset device inode path", only executable mappings of files are
+    of interest. Mappings are stored behind the content, which stays in the arena, since paths point into it.
+   */
+  reserve(arena, size);
+
+  auto mappings = get_memory_at_current_offset<Module_Mapping>(arena);
+  usize count = 0;
+
+  for (const char *cursor = content, *end = content + size; cursor < end;) {
+    auto line_end = get_character_offset(cursor, end, '\n');
+    if (!line_end) line_end = end;
+
+    Module_Mapping mapping;
+
+    auto field = cursor;
+    cursor = line_end + 1;
+
+    if (!parse_hex(field, line_end, mapping.start) || *field++ != '-') continue;
+    if (!parse_hex(field, line_end, mapping.end)) continue;
+
+    field = skip_field(field, line_end);
+    if (line_end - field < 4 || field[2] != 'x') continue;
+
+    field = skip_field(field, line_end);
+    if (!parse_hex(field, line_end, mapping.file_offset)) continue;
+
+    // Past the offset, the device and the inode to the path.
+    for (int idx = 0; idx < 3; idx++) field = skip_field(field, line_end);
+
+    if (field == line_end || *field != '/') continue;
+
+    mapping.path = String(field, line_end - field);
+
+    auto slot = reserve<Module_Mapping>(arena);
+    if (!slot) return System_Error { "not enough memory in the arena for the process' mappings", ENOMEM };
+
+    *slot = mapping;
+    count += 1;
+  }
+
+  return Array(mappings, count);
+}
+
+}
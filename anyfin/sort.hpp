@@ -0,0 +1,53 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/meta.hpp"
+#include "anyfin/slice.hpp"
+
+namespace Fin {
+
+template <typename T>
+fin_forceinline
+constexpr void swap_values (T &a, T &b) {
+  T temp = move(a);
+  a = move(b);
+  b = move(temp);
+}
+
+/*
+  In-place heap sort. It's not stable, but has no recursion, doesn't allocate and has guaranteed O(n log n)
+  running time regardless of the input's order.
+ */
+template <typename T>
+constexpr void sort (Slice<T> values, const Invocable<bool, const T &, const T &> auto &less) {
+  if (values.count < 2) return;
+
+  auto data = values.values;
+
+  const auto sift_down = [&] (usize root, usize count) {
+    while (true) {
+      auto child = 2 * root + 1;
+      if (child >= count) return;
+
+      if ((child + 1 < count) && less(data[child], data[child + 1])) child += 1;
+      if (!less(data[root], data[child])) return;
+
+      swap_values(data[root], data[child]);
+      root = child;
+    }
+  };
+
+  for (usize idx = values.count / 2; idx > 0; idx--) sift_down(idx - 1, values.count);
+
+  for (usize end = values.count - 1; end > 0; end--) {
+    swap_values(data[0], data[end]);
+    sift_down(0, end);
+  }
+}
+
+template <typename T>
+constexpr void sort (Slice<T> values) {
+  sort(values, [] (const T &a, const T &b) { return a < b; });
+}
+
+}
@@ -36,34 +36,17 @@ static auto to_string (Byte_Array<N> auto (&value)[N], Memory_Arena &arena) {
 
 template <Integral I>
 static String to_string (I value, Memory_Arena &arena) {
-  char buffer[20];
-  usize offset = 0;
-  
-  bool is_negative = false;
-  if constexpr (Signed_Integral<I>) {
-    if (value < 0) {
-      is_negative = true;
-      value       = -value; 
-    }
-  }
+  auto string = write_integer(arena, value);
+  if (!string.length) return {};
 
-  do {
-    const auto digit = value % 10;
-    buffer[offset++] = '0' + digit;
-    value /= 10;
-  } while (value != 0);
+  auto terminator = reserve<char>(arena, 1, alignof(char));
+  fin_ensure(terminator);
 
-  if constexpr (Signed_Integral<I>) {
-    if (is_negative) buffer[offset++] = '-';
-  }
+  if (!terminator) return {};
 
-  auto string = reserve<char>(arena, offset + 1);
-  for (usize idx = 0; idx < offset; idx++) {
-    string[idx] = buffer[offset - 1 - idx];
-  }
-  string[offset] = '\0';
-  
-  return String(string, offset);
+  *terminator = '\0';
+
+  return string;
 }
 
 static auto to_string (const Callsite &callsite, Memory_Arena &arena) {
@@ -84,23 +67,7 @@ static auto to_string (const Callsite &callsite, Memory_Arena &arena) {
     *buffer = '(';
   }
   
-  {
-    char temp_buffer[20];
-    usize offset = 0;
-
-    auto value = callsite.line;
-
-    do {
-      const auto digit = value % 10;
-      temp_buffer[offset++] = '0' + digit;
-      value /= 10;
-    } while (value != 0);
-
-    auto buffer = reserve<char>(arena, offset);
-    for (usize idx = 0; idx < offset; idx++) {
-      buffer[idx] = temp_buffer[offset - 1 - idx];
-    }
-  }
+  write_integer(arena, callsite.line);
 
   {
     auto buffer = reserve<char>(arena, 2);
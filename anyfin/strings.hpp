@@ -6,6 +6,8 @@
 #include "anyfin/memory.hpp"
 #include "anyfin/meta.hpp"
 #include "anyfin/prelude.hpp"
+#include "anyfin/seq.hpp"
+#include "anyfin/slice.hpp"
 
 namespace Fin {
 
@@ -138,7 +140,205 @@ constexpr bool ends_with (String view, String end) {
   return true; 
 }
 
+/*
+  Lexicographical comparison of the bytes, returns a negative value if the left string is ordered before the
+  right one, zero if they are equal and a positive value otherwise.
+ */
+constexpr s32 compare_strings (String left, String right) {
+  auto common_length = left.length < right.length ? left.length : right.length;
+
+  if (common_length) {
+    auto status = __builtin_memcmp(left.value, right.value, common_length);
+    if (status) return status;
+  }
+
+  if (left.length == right.length) return 0;
+
+  return left.length < right.length ? -1 : 1;
+}
+
+/*
+  Two-Way string matching (Crochemore & Perrin), linear in the text's length regardless of the pattern, used
+  for the inputs where candidate verification of the vector search degenerates, e.g. "aaa...ab" in "aaa...a".
+  The pattern is split at its critical factorization: the right part is matched left to right, then the left
+  part right to left, and shifts use the pattern's period to avoid rescanning known matching bytes.
+ */
+static usize get_critical_factorization (const u8 *pattern, usize length, usize &period) {
+  // Maximal suffixes are tracked for both orderings of the alphabet, the longer one gives the factorization.
+  usize suffixes[2], periods[2];
+
+  for (usize ordering = 0; ordering < 2; ordering++) {
+    usize max_suffix = usize(-1), cursor = 0, offset = 1, candidate_period = 1;
+
+    while (cursor + offset < length) {
+      auto a = pattern[cursor + offset];
+      auto b = pattern[max_suffix + offset];
+
+      if (ordering ? (b < a) : (a < b)) {
+        cursor          += offset;
+        offset           = 1;
+        candidate_period = cursor - max_suffix;
+      }
+      else if (a == b) {
+        if (offset != candidate_period) offset += 1;
+        else {
+          cursor += candidate_period;
+          offset  = 1;
+        }
+      }
+      else {
+        max_suffix       = cursor++;
+        offset           = 1;
+        candidate_period = 1;
+      }
+    }
+
+    suffixes[ordering] = max_suffix + 1;
+    periods[ordering]  = candidate_period;
+  }
+
+  auto selected = suffixes[1] < suffixes[0] ? 0 : 1;
+  period = periods[selected];
+
+  return suffixes[selected];
+}
+
+static const char * find_substring_two_way (const char *text, usize text_length, const char *pattern_bytes, usize pattern_length) {
+  if (text_length < pattern_length) return nullptr;
+
+  auto haystack = reinterpret_cast<const u8 *>(text);
+  auto pattern  = reinterpret_cast<const u8 *>(pattern_bytes);
+
+  usize period;
+  auto  suffix = get_critical_factorization(pattern, pattern_length, period);
+
+  if (compare_bytes(pattern, pattern + period, suffix)) {
+    // Periodic pattern, the prefix matched on the previous attempt is remembered to not be compared again.
+    usize memory = 0;
+
+    for (usize position = 0; position <= text_length - pattern_length;) {
+      auto idx = suffix > memory ? suffix : memory;
+      while (idx < pattern_length && pattern[idx] == haystack[position + idx]) idx += 1;
+
+      if (idx < pattern_length) {
+        position += idx - suffix + 1;
+        memory    = 0;
+        continue;
+      }
+
+      idx = suffix;
+      while (idx > memory && pattern[idx - 1] == haystack[position + idx - 1]) idx -= 1;
+      if (idx <= memory) return text + position;
+
+      position += period;
+      memory    = pattern_length - period;
+    }
+  }
+  else {
+    period = (suffix > pattern_length - suffix ? suffix : pattern_length - suffix) + 1;
+
+    for (usize position = 0; position <= text_length - pattern_length;) {
+      auto idx = suffix;
+      while (idx < pattern_length && pattern[idx] == haystack[position + idx]) idx += 1;
+
+      if (idx < pattern_length) {
+        position += idx - suffix + 1;
+        continue;
+      }
+
+      idx = suffix;
+      while (idx > 0 && pattern[idx - 1] == haystack[position + idx - 1]) idx -= 1;
+      if (idx == 0) return text + position;
+
+      position += period;
+    }
+  }
+
+  return nullptr;
+}
+
+#ifdef CPU_ARCH_X64
+
+/*
+  Vector filter over the positions where both the first and the last bytes of the pattern match, only those are
+  compared in full. Returns the match, or stops at `position`, from which the search must continue: either at
+  the tail that doesn't fill a whole vector, or earlier, when the verification of false candidates outweighs the
+  scanning, in which case the linear fallback is the better choice.
+ */
+static const char * find_substring_sse2 (const char *text, usize text_length, const char *pattern, usize pattern_length, usize &position) {
+  const auto first = _mm_set1_epi8(pattern[0]);
+  const auto last  = _mm_set1_epi8(pattern[pattern_length - 1]);
+
+  usize verified = 0;
+  for (; position + pattern_length - 1 + 16 <= text_length; position += 16) {
+    auto block_first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + position));
+    auto block_last  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + position + pattern_length - 1));
+
+    auto mask = static_cast<u32>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last))));
+    for (; mask; mask &= mask - 1) {
+      auto candidate = text + position + __builtin_ctz(mask);
+      if (compare_bytes(candidate + 1, pattern + 1, pattern_length - 2)) return candidate;
+
+      verified += pattern_length;
+    }
+
+    if (verified > 4 * position + 4096) break;
+  }
+
+  return nullptr;
+}
+
+fin_target_avx2
+static const char * find_substring_avx2 (const char *text, usize text_length, const char *pattern, usize pattern_length, usize &position) {
+  const auto first = _mm256_set1_epi8(pattern[0]);
+  const auto last  = _mm256_set1_epi8(pattern[pattern_length - 1]);
+
+  usize verified = 0;
+  for (; position + pattern_length - 1 + 32 <= text_length; position += 32) {
+    auto block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + position));
+    auto block_last  = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + position + pattern_length - 1));
+
+    auto mask = static_cast<u32>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last))));
+    for (; mask; mask &= mask - 1) {
+      auto candidate = text + position + __builtin_ctz(mask);
+      if (compare_bytes(candidate + 1, pattern + 1, pattern_length - 2)) return candidate;
+
+      verified += pattern_length;
+    }
+
+    if (verified > 4 * position + 4096) break;
+  }
+
+  return nullptr;
+}
+
+#endif
+
+/*
+  Position of the first occurrence of the value in the text, nullptr if there's none. An empty value is found
+  at the start of the text.
+ */
+static const char * find_substring (String text, String value) {
+  if (value.length == 0)          return text.value;
+  if (text.length < value.length) return nullptr;
+  if (value.length == 1)          return get_character_offset(text.value, text.length, value[0]);
+
+  usize position = 0;
+
+#ifdef CPU_ARCH_X64
+  auto match = is_avx2_available
+    ? find_substring_avx2(text.value, text.length, value.value, value.length, position)
+    : find_substring_sse2(text.value, text.length, value.value, value.length, position);
+
+  if (match) return match;
+#endif
+
+  return find_substring_two_way(text.value + position, text.length - position, value.value, value.length);
+}
+
 constexpr bool has_substring (String text, String value) {
+  if (!__builtin_is_constant_evaluated()) return find_substring(text, value) != nullptr;
+
   if (value.length == 0)          return true;
   if (text.length < value.length) return false;
 
@@ -149,14 +349,308 @@ constexpr bool has_substring (String text, String value) {
   return false;
 }
 
+/*
+  Visit all occurrences of any of the patterns in the text, ordered by their positions (by the patterns' order
+  for the same position), overlapping ones included, e.g. when scanning logs for a set of error signatures.
+  `on_match(usize offset, usize pattern_index)` returns false to stop the search. Each pattern's next occurrence
+  is looked up only once the previous one has been reported, thus the text is scanned once per pattern, the
+  arena holds these positions during the search. Returns false if the arena has no space for them.
+ */
+static bool for_each_match (Memory_Arena arena, String text, Slice<const String> patterns,
+                            const Invocable<bool, usize, usize> auto &on_match) {
+  auto next = reserve<const char *>(arena, sizeof(const char *) * patterns.count);
+  if (!next && patterns.count) return false;
+
+  for (usize idx = 0; idx < patterns.count; idx++) next[idx] = find_substring(text, patterns[idx]);
+
+  const auto text_end = text.value + text.length;
+
+  while (true) {
+    usize selected = patterns.count;
+    for (usize idx = 0; idx < patterns.count; idx++) {
+      if (next[idx] && (selected == patterns.count || next[idx] < next[selected])) selected = idx;
+    }
+
+    if (selected == patterns.count) return true;
+
+    auto position = next[selected];
+    if (!on_match(static_cast<usize>(position - text.value), selected)) return true;
+
+    // Empty patterns would match at every position, they are reported once.
+    if (patterns[selected].length == 0) {
+      next[selected] = nullptr;
+      continue;
+    }
+
+    next[selected] = find_substring(String(position + 1, text_end - position - 1), patterns[selected]);
+  }
+}
+
+/*
+  Integer rendering. Decimal digits are produced from a table of pairs, four digits per division by 10000 that
+  split into two independent pair lookups, and the number of digits is known upfront, so the output is written
+  directly at its place, from the end, without an intermediate buffer and reversal.
+ */
+constexpr char decimal_digit_pairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+constexpr u64 powers_of_ten[20] {
+  1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull,
+  10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull,
+  1000000000000000ull, 10000000000000000ull, 100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull,
+};
+
+/*
+  Estimated from the bit length (1233 / 4096 approximates log10(2)) and corrected with a single comparison.
+  Zero has one digit.
+ */
+fin_forceinline
+static usize get_decimal_digits_count (u64 value) {
+  value |= 1;
+
+  auto estimate = ((64 - __builtin_clzll(value)) * 1233) >> 12;
+  return estimate + 1 - (value < powers_of_ten[estimate]);
+}
+
+fin_forceinline
+static usize get_hex_digits_count (u64 value) {
+  return (64 - __builtin_clzll(value | 1) + 3) / 4;
+}
+
+/*
+  Writes the digits of the value backwards, finishing right before `end`.
+ */
+fin_forceinline
+static void write_decimal_digits (char *end, u64 value) {
+  while (value >= 10000) {
+    auto quad = value % 10000;
+    value /= 10000;
+
+    auto high = (quad / 100) * 2, low = (quad % 100) * 2;
+
+    end -= 4;
+    end[0] = decimal_digit_pairs[high];
+    end[1] = decimal_digit_pairs[high + 1];
+    end[2] = decimal_digit_pairs[low];
+    end[3] = decimal_digit_pairs[low + 1];
+  }
+
+  if (value >= 100) {
+    auto pair = (value % 100) * 2;
+    value /= 100;
+
+    end -= 2;
+    end[0] = decimal_digit_pairs[pair];
+    end[1] = decimal_digit_pairs[pair + 1];
+  }
+
+  if (value >= 10) {
+    end[-2] = decimal_digit_pairs[value * 2];
+    end[-1] = decimal_digit_pairs[value * 2 + 1];
+  }
+  else end[-1] = static_cast<char>('0' + value);
+}
+
+/*
+  Renders the number's digits at the end of the provided buffer, without allocating, zero-padded to at least
+  `min_digits`. The returned view points into the buffer.
+ */
+fin_forceinline
+static String render_unsigned (char (&buffer)[24], u64 value, usize min_digits = 0) {
+  fin_ensure(min_digits <= sizeof(buffer));
+
+  auto digits = get_decimal_digits_count(value);
+  auto length = digits < min_digits ? min_digits : digits;
+  auto end    = buffer + sizeof(buffer);
+
+  write_decimal_digits(end, value);
+  for (auto cursor = end - digits; cursor > end - length;) *--cursor = '0';
+
+  return String(end - length, length);
+}
+
+fin_forceinline
+static String render_signed (char (&buffer)[24], s64 value, usize min_digits = 0) {
+  // Negated in the unsigned domain, which is well defined for the minimal value as well.
+  u64 magnitude = value < 0 ? 0ull - static_cast<u64>(value) : static_cast<u64>(value);
+
+  auto digits = render_unsigned(buffer, magnitude, min_digits > 23 ? 23 : min_digits);
+  if (value >= 0) return digits;
+
+  auto start = const_cast<char *>(digits.value) - 1;
+  *start = '-';
+
+  return String(start, digits.length + 1);
+}
+
+/*
+  Same as render_unsigned, but in lowercase hexadecimal, without the prefix.
+ */
+fin_forceinline
+static String render_hex (char (&buffer)[24], u64 value, usize min_digits = 0) {
+  fin_ensure(min_digits <= 16);
+
+  auto digits = get_hex_digits_count(value);
+  auto length = digits < min_digits ? min_digits : digits;
+  auto cursor = buffer + sizeof(buffer);
+
+  for (usize idx = 0; idx < length; idx++) {
+    *--cursor = "0123456789abcdef"[value & 0xf];
+    value >>= 4;
+  }
+
+  return String(cursor, length);
+}
+
+fin_forceinline
+static String render_binary (char (&buffer)[64], u64 value, usize min_digits = 0) {
+  fin_ensure(min_digits <= 64);
+
+  usize digits = 64 - __builtin_clzll(value | 1);
+  auto  length = digits < min_digits ? min_digits : digits;
+  auto  cursor = buffer + sizeof(buffer);
+
+  for (usize idx = 0; idx < length; idx++) {
+    *--cursor = static_cast<char>('0' + (value & 1));
+    value >>= 1;
+  }
+
+  return String(cursor, length);
+}
+
+/*
+  Renders the integer in decimal at the arena's current offset without the terminating zero, so that more output
+  could follow it directly, as formatting does.
+ */
+template <Integral I>
+static String write_integer (Memory_Arena &arena, I value) {
+  bool is_negative = false;
+  u64  magnitude   = static_cast<u64>(value);
+
+  if constexpr (Signed_Integral<I>) {
+    is_negative = value < 0;
+    if (is_negative) magnitude = 0ull - static_cast<u64>(static_cast<s64>(value));
+  }
+
+  auto length = get_decimal_digits_count(magnitude) + is_negative;
+  auto memory = reserve<char>(arena, length, alignof(char));
+  fin_ensure(memory);
+
+  if (!memory) return {};
+
+  if (is_negative) memory[0] = '-';
+  write_decimal_digits(memory + length, magnitude);
+
+  return String(memory, length);
+}
+
+/*
+  Set of up to 16 characters, e.g. the whitespace class " \t\r\n" for tokenizing.
+ */
+struct Char_Class {
+  char  values[16] {};
+  usize count = 0;
+
+  constexpr Char_Class (char value)
+    : values { value }, count { 1 } {}
+
+  template <usize N>
+  constexpr Char_Class (const char (&literal)[N])
+    : count { N - 1 }
+  {
+    static_assert(N > 1 && N - 1 <= 16, "character class must have from 1 to 16 characters");
+    for (usize idx = 0; idx < N - 1; idx++) values[idx] = literal[idx];
+  }
+
+  constexpr bool contains (char value) const {
+    for (usize idx = 0; idx < count; idx++) {
+      if (values[idx] == value) return true;
+    }
+
+    return false;
+  }
+};
+
+/*
+  Text is classified in blocks of 64 bytes, each turned into a bitmask of positions holding the class' characters,
+  which is handed to `on_block(const char *block, u64 mask)`. Positions of the last, partial block that are past
+  the end of the text are marked as matching.
+ */
+static u64 match_char_class (const char *block, usize length, const Char_Class &characters) {
+  u64 mask = length < 64 ? ~u64(0) << length : 0;
+  for (usize idx = 0; idx < length; idx++) {
+    if (characters.contains(block[idx])) mask |= u64(1) << idx;
+  }
+
+  return mask;
+}
+
+#ifdef CPU_ARCH_X64
+
+static const char * scan_char_class_sse2 (const char *cursor, const char *end, const Char_Class &characters, const auto &on_block) {
+  __m128i needles[16] { _mm_set1_epi8(characters.values[0]) };
+  for (usize idx = 1; idx < characters.count; idx++) needles[idx] = _mm_set1_epi8(characters.values[idx]);
+
+  for (; end - cursor >= 64; cursor += 64) {
+    u64 mask = 0;
+    for (usize part = 0; part < 4; part++) {
+      auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cursor) + part);
+      mask |= u64(match_bytes_sse2(chunk, needles, characters.count)) << (part * 16);
+    }
+
+    on_block(cursor, mask);
+  }
+
+  return cursor;
+}
+
+fin_target_avx2
+static const char * scan_char_class_avx2 (const char *cursor, const char *end, const Char_Class &characters, const auto &on_block) {
+  __m256i needles[16] { _mm256_set1_epi8(characters.values[0]) };
+  for (usize idx = 1; idx < characters.count; idx++) needles[idx] = _mm256_set1_epi8(characters.values[idx]);
+
+  for (; end - cursor >= 64; cursor += 64) {
+    auto low  = match_bytes_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(cursor)),     needles, characters.count);
+    auto high = match_bytes_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(cursor) + 1), needles, characters.count);
+
+    on_block(cursor, u64(low) | (u64(high) << 32));
+  }
+
+  return cursor;
+}
+
+#endif
+
+static void scan_char_class (const char *cursor, const char *end, const Char_Class &characters, const auto &on_block) {
+#ifdef CPU_ARCH_X64
+  cursor = is_avx2_available
+    ? scan_char_class_avx2(cursor, end, characters, on_block)
+    : scan_char_class_sse2(cursor, end, characters, on_block);
+#endif
+
+  for (; cursor < end; cursor += 64) {
+    auto length = static_cast<usize>(end - cursor);
+    on_block(cursor, match_char_class(cursor, length < 64 ? length : 64, characters));
+  }
+}
+
+/*
+  Splits the string into tokens separated by one or more separators, thus empty tokens are never produced.
+  Separators are located 64 bytes at a time, and tokens are cut at the boundaries between separator and
+  non-separator runs, found as the changes in the separators' bitmask.
+
+    split_string(line, Char_Class(" \t")).for_each([] (String token) { ... });
+ */
 struct split_string {
   const char *cursor = nullptr;
   const char *end    = nullptr;
 
-  char separator;
+  Char_Class separators;
   
-  constexpr split_string (String _string, char _separator)
-    : separator { _separator }
+  constexpr split_string (String _string, Char_Class _separators)
+    : separators { _separators }
   {
     if (is_empty(_string)) return;
       
@@ -164,37 +658,91 @@ struct split_string {
     end    = cursor + _string.length;
   }
 
-  constexpr void for_each (const Invocable<void, String> auto &func) {
-    while (end_reached() == false) {
-      if (skip_consequtive_separators()) return;
+  constexpr split_string (String _string, char _separator)
+    : split_string(_string, Char_Class(_separator)) {}
 
-      auto next_position = get_character_offset(cursor, end - cursor, separator);
-      fin_ensure(next_position != cursor); // We've just skipped all separators, this wouldn't make any sense.
+  constexpr void for_each (const Invocable<void, String> auto &func) {
+    if (end_reached()) return;
 
-      if (next_position) {
-        func(String(cursor, next_position - cursor));
+    if (__builtin_is_constant_evaluated()) {
+      while (!skip_consequtive_separators()) {
+        auto token_start = cursor;
+        while (!end_reached() && !separators.contains(*cursor)) cursor += 1;
 
-        cursor = next_position;
-        continue;
+        func(String(token_start, cursor - token_start));
       }
-      
-      func(String(cursor, end - cursor));
-      
-      cursor = end;
+
+      return;
     }
+
+    /*
+      A boundary is where a position's bit differs from the previous one's, the bit before the text counts as
+      a separator, so boundaries alternate between token starts and ends.
+     */
+    const char *token_start  = nullptr;
+    u64         previous_bit = 1;
+
+    scan_char_class(cursor, end, separators, [&] (const char *block, u64 mask) {
+      auto boundaries = mask ^ ((mask << 1) | previous_bit);
+
+      for (; boundaries; boundaries &= boundaries - 1) {
+        auto position = block + __builtin_ctzll(boundaries);
+
+        if (token_start) {
+          func(String(token_start, position - token_start));
+          token_start = nullptr;
+        }
+        else token_start = position;
+      }
+
+      previous_bit = mask >> 63;
+    });
+
+    if (token_start) func(String(token_start, end - token_start));
+
+    cursor = end;
+  }
+
+  /*
+    Number of tokens the string would be split into, without producing them.
+   */
+  usize count_tokens () const {
+    if (end_reached()) return 0;
+
+    usize count        = 0;
+    u64   previous_bit = 1;
+
+    scan_char_class(cursor, end, separators, [&] (const char *, u64 mask) {
+      count        += __builtin_popcountll(~mask & ((mask << 1) | previous_bit));
+      previous_bit  = mask >> 63;
+    });
+
+    return count;
   }
 
   constexpr bool skip_consequtive_separators () {
     while (!end_reached()) {
-      if (*cursor != separator) return false;
+      if (!separators.contains(*cursor)) return false;
       cursor += 1;
     }
 
     return true;
   }
 
-  constexpr bool end_reached () { return cursor == end; }
+  constexpr bool end_reached () const { return cursor == end; }
 };
 
+/*
+  All tokens of the string in one go, placed into the arena. The tokens are counted first, so that the sequence
+  is allocated at once with its exact size.
+ */
+static Seq<String> collect_tokens (Memory_Arena &arena, split_string splitter) {
+  auto tokens = reserve_seq<String>(arena, splitter.count_tokens());
+  if (!tokens.values) return {};
+
+  splitter.for_each([&tokens] (String token) { seq_push_copy(tokens, token); });
+
+  return tokens;
+}
+
 }
-  
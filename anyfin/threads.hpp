@@ -21,6 +21,11 @@ static Sys_Result<Thread> spawn_thread (const Invocable<void, T *> auto &proc, T
 
 static Sys_Result<void> shutdown_thread (Thread &thread);
 
+/*
+  Block until the thread finishes its procedure, releasing the thread's resources afterwards.
+ */
+static Sys_Result<void> wait_for_thread (Thread &thread);
+
 static void thread_sleep (usize milliseconds);
 
 static u32 get_current_thread_id ();
@@ -30,6 +35,8 @@ static u32 get_current_thread_id ();
 #ifndef FIN_THREADS_HPP_IMPL
   #ifdef PLATFORM_WIN32
     #include "anyfin/threads_win32.hpp"
+  #elif defined(PLATFORM_LINUX)
+    #include "anyfin/threads_linux.hpp"
   #else
     #error "Unsupported platform"
   #endif
@@ -0,0 +1,65 @@
+
+#define FIN_THREADS_HPP_IMPL
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "anyfin/threads.hpp"
+
+namespace Fin {
+
+/*
+  pthread's entry point receives a single pointer, thus the procedure must be stateless (i.e a lambda without
+  captures), so that it could be reconstructed on the new thread's side.
+ */
+template <typename T>
+static Sys_Result<Thread> spawn_thread (const Invocable<void, T *> auto &proc, T *data) {
+  using Proc = raw_type<decltype(proc)>;
+
+  void * (*entry) (void *) = [] (void *data) -> void * {
+    Proc{}(static_cast<T *>(data));
+    return nullptr;
+  };
+
+  pthread_t handle;
+  if (auto status = pthread_create(&handle, nullptr, entry, data); status != 0) {
+    errno = status;
+    return Error(get_system_error());
+  }
+
+  // Kernel's thread id is only available from within the thread itself.
+  return Ok(Thread { reinterpret_cast<Thread::Handle *>(handle), 0 });
+}
+
+static Sys_Result<Thread> spawn_thread (const Invocable<void> auto &proc) {
+  using Proc = raw_type<decltype(proc)>;
+
+  return spawn_thread<void>([] (void *) { Proc{}(); }, nullptr);
+}
+
+static Sys_Result<void> wait_for_thread (Thread &thread) {
+  if (auto status = pthread_join(reinterpret_cast<pthread_t>(thread.handle), nullptr); status != 0) {
+    errno = status;
+    return Error(get_system_error());
+  }
+
+  thread.handle = nullptr;
+
+  return Ok();
+}
+
+static u32 get_current_thread_id () {
+  return static_cast<u32>(gettid());
+}
+
+static void thread_sleep (usize milliseconds) {
+  timespec duration {
+    .tv_sec  = static_cast<time_t>(milliseconds / 1000),
+    .tv_nsec = static_cast<long>((milliseconds % 1000) * 1'000'000),
+  };
+
+  while (nanosleep(&duration, &duration) != 0 && errno == EINTR);
+}
+
+}
@@ -5,21 +5,44 @@
 
 namespace Fin {
 
+/*
+  Thread's entry point receives a single pointer, thus the procedure must be stateless (i.e a lambda without
+  captures), so that it could be reconstructed on the new thread's side.
+ */
+template <typename Proc, typename T>
+static DWORD WINAPI thread_entry (LPVOID data) {
+  Proc{}(static_cast<T *>(data));
+  return 0;
+}
+
 template <typename T>
 static Sys_Result<Thread> spawn_thread (const Invocable<void, T *> auto &proc, T *data) {
+  using Proc = raw_type<decltype(proc)>;
+
   DWORD thread_id;
-  auto handle = CreateThread(nullptr, 0, reinterpret_cast<LPTHREAD_START_ROUTINE>(proc), data, 0, &thread_id);
+  auto handle = CreateThread(nullptr, 0, thread_entry<Proc, T>, data, 0, &thread_id);
   if (!handle) return Error(get_system_error());
 
   return Ok(Thread { reinterpret_cast<Thread::Handle *>(handle), thread_id });
 }
 
 static Sys_Result<Thread> spawn_thread (const Invocable<void> auto &proc) {
-  return spawn_thread(nullptr, proc);
+  using Proc = raw_type<decltype(proc)>;
+
+  return spawn_thread<void>([] (void *) { Proc{}(); }, nullptr);
 }
 
 static Sys_Result<void> shutdown_thread (Thread &thread);
 
+static Sys_Result<void> wait_for_thread (Thread &thread) {
+  if (WaitForSingleObject(thread.handle, INFINITE) == WAIT_FAILED) return Error(get_system_error());
+  if (!CloseHandle(thread.handle))                                   return Error(get_system_error());
+
+  thread.handle = nullptr;
+
+  return Ok();
+}
+
 static u32 get_current_thread_id () {
   return GetCurrentThreadId();
 }
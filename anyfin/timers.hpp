@@ -12,17 +12,51 @@ static Result<Timer_Error, void> enable_high_precision_timer ();
 
 static void disable_high_precision_timer ();
 
+/*
+  Select the timer source and measure its frequency, which may block for a few dozen milliseconds. Otherwise
+  it happens on the first use of the timer, call it upfront to keep the cost out of measured code.
+ */
+static void calibrate_timer ();
+
+/*
+  Number of timer ticks per second. On Linux with an invariant TSC ticks are TSC cycles, otherwise it's
+  whatever the platform's clock counts in (nanoseconds for clock_gettime, QPC units on Windows).
+ */
 static u64 get_timer_frequency ();
 
 static u64 get_timer_value ();
 
+/*
+  Same as get_timer_value, but isn't reordered before the preceding instructions, for the end of a measured region.
+ */
+static u64 get_timer_value_serialized ();
+
 static u64 get_elapsed_millis (u64 frequency, u64 from, u64 to);
 
+/*
+  Conversions between timer ticks and nanoseconds. Ticks are split into whole seconds and the remainder, which
+  keeps the intermediate product within 64 bits for any realistic frequency.
+ */
+constexpr u64 convert_ticks_to_nanos (u64 frequency, u64 ticks) {
+  return (ticks / frequency) * 1'000'000'000ull + ((ticks % frequency) * 1'000'000'000ull) / frequency;
+}
+
+constexpr u64 convert_nanos_to_ticks (u64 frequency, u64 nanos) {
+  return (nanos / 1'000'000'000ull) * frequency + ((nanos % 1'000'000'000ull) * frequency) / 1'000'000'000ull;
+}
+
+fin_forceinline
+static u64 get_elapsed_nanos (u64 frequency, u64 from, u64 to) {
+  return convert_ticks_to_nanos(frequency, to - from);
+}
+
 }
 
 #ifndef FIN_TIMERS_HPP_IMPL
   #ifdef PLATFORM_WIN32
     #include "anyfin/timers_win32.hpp"
+  #elif defined(PLATFORM_LINUX)
+    #include "anyfin/timers_linux.hpp"
   #else
     #error "Unsupported platform"
   #endif
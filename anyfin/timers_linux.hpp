@@ -0,0 +1,184 @@
+
+#define FIN_TIMERS_HPP_IMPL
+
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef CPU_ARCH_X64
+  #include <cpuid.h>
+  #include <x86intrin.h>
+#endif
+
+#include "anyfin/atomics.hpp"
+#include "anyfin/timers.hpp"
+
+namespace Fin {
+
+static Result<Timer_Error, void> enable_high_precision_timer () { return Ok(); }
+
+static void disable_high_precision_timer () {}
+
+enum struct Timer_Source: u32 { Unknown, Selecting, Time_Stamp_Counter, Monotonic_Clock };
+
+/*
+  Timer source is selected once, by calibrate_timer or on first use. The first caller claims the selection,
+  concurrent callers wait until it's published. The frequency is stored before the source is released, thus
+  any thread observing a selected source reads the final frequency.
+ */
+static Atomic<Timer_Source> timer_source;
+static au64                 timer_frequency;
+
+static u64 get_monotonic_nanos () {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return static_cast<u64>(now.tv_sec) * 1'000'000'000ull + static_cast<u64>(now.tv_nsec);
+}
+
+#ifdef CPU_ARCH_X64
+
+/*
+  Invariant TSC runs at a constant rate across P/C-states and is synchronized between cores. The kernel may
+  still find it unreliable (e.g. on some VMs) and switch to another clocksource, in which case it's not used.
+ */
+static bool is_time_stamp_counter_usable () {
+  u32 eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) return false;
+
+  __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+  if (!(edx & (1u << 8))) return false;
+
+  auto file = open("/sys/devices/system/clocksource/clocksource0/current_clocksource", O_RDONLY | O_CLOEXEC);
+  if (file < 0) return true;
+
+  char name[16] {};
+  auto bytes_read = read(file, name, sizeof(name) - 1);
+  close(file);
+
+  if (bytes_read < 3) return true;
+
+  return name[0] == 't' && name[1] == 's' && name[2] == 'c';
+}
+
+/*
+  Newer CPUs report the TSC frequency through the crystal clock ratio in leaf 0x15, which is exact. Otherwise
+  it's measured against CLOCK_MONOTONIC over a short interval, bracketing each clock read with TSC reads and
+  keeping the tightest pair to limit the error from preemption.
+ */
+static u64 calibrate_time_stamp_counter () {
+  u32 eax, ebx, ecx, edx;
+  if (__get_cpuid_count(0x15, 0, &eax, &ebx, &ecx, &edx) && eax && ebx && ecx)
+    return static_cast<u64>(ecx) * ebx / eax;
+
+  const auto sample = [] (u64 &nanos) -> u64 {
+    u64 best_window = static_cast<u64>(-1), stamp = 0;
+
+    for (int attempt = 0; attempt < 8; attempt++) {
+      auto before = __rdtsc();
+      auto clock  = get_monotonic_nanos();
+      auto after  = __rdtsc();
+
+      if (after - before < best_window) {
+        best_window = after - before;
+        stamp       = before + best_window / 2;
+        nanos       = clock;
+      }
+    }
+
+    return stamp;
+  };
+
+  u64 start_nanos, end_nanos;
+  auto start = sample(start_nanos);
+
+  timespec interval { .tv_sec = 0, .tv_nsec = 20'000'000 };
+  while (nanosleep(&interval, &interval) != 0) {}
+
+  auto end = sample(end_nanos);
+
+  auto elapsed_nanos = end_nanos - start_nanos;
+  if (elapsed_nanos == 0) return 0;
+
+  auto ticks = end - start;
+
+  // Keeps the product within 64 bits, the same way as convert_ticks_to_nanos.
+  return (ticks / elapsed_nanos) * 1'000'000'000ull + ((ticks % elapsed_nanos) * 1'000'000'000ull) / elapsed_nanos;
+}
+
+#endif
+
+[[gnu::noinline]]
+static Timer_Source select_timer_source () {
+  if (!atomic_compare_and_set(timer_source, Timer_Source::Unknown, Timer_Source::Selecting)) {
+    // Calibration takes a few dozen milliseconds at most, there's no point in anything fancier than yielding.
+    auto source = atomic_load<Memory_Order::Acquire>(timer_source);
+    for (; source == Timer_Source::Selecting; source = atomic_load<Memory_Order::Acquire>(timer_source)) sched_yield();
+
+    return source;
+  }
+
+  auto source    = Timer_Source::Monotonic_Clock;
+  auto frequency = 1'000'000'000ull;
+
+#ifdef CPU_ARCH_X64
+  if (is_time_stamp_counter_usable()) {
+    if (auto tsc_frequency = calibrate_time_stamp_counter()) {
+      source    = Timer_Source::Time_Stamp_Counter;
+      frequency = tsc_frequency;
+    }
+  }
+#endif
+
+  atomic_store(timer_frequency, frequency);
+  atomic_store<Memory_Order::Release>(timer_source, source);
+
+  return source;
+}
+
+fin_forceinline
+static Timer_Source get_timer_source () {
+  auto source = atomic_load<Memory_Order::Acquire>(timer_source);
+  if (source == Timer_Source::Unknown || source == Timer_Source::Selecting) [[unlikely]] source = select_timer_source();
+
+  return source;
+}
+
+static void calibrate_timer () {
+  get_timer_source();
+}
+
+static u64 get_timer_frequency () {
+  get_timer_source();
+  return atomic_load(timer_frequency);
+}
+
+/*
+  clock_gettime with CLOCK_MONOTONIC is served by the vDSO without entering the kernel, but still costs
+  a couple of times more than reading the TSC directly.
+ */
+static u64 get_timer_value () {
+#ifdef CPU_ARCH_X64
+  if (get_timer_source() == Timer_Source::Time_Stamp_Counter) [[likely]] return __rdtsc();
+#endif
+
+  return get_monotonic_nanos();
+}
+
+static u64 get_timer_value_serialized () {
+#ifdef CPU_ARCH_X64
+  if (get_timer_source() == Timer_Source::Time_Stamp_Counter) [[likely]] {
+    u32 processor_id;
+    return __rdtscp(&processor_id);
+  }
+#endif
+
+  return get_monotonic_nanos();
+}
+
+static u64 get_elapsed_millis (u64 frequency, u64 from, u64 to) {
+  return convert_ticks_to_nanos(frequency, to - from) / 1'000'000;
+}
+
+}
@@ -17,6 +17,11 @@ namespace Fin {
 //   timeEndPeriod(1);
 // }
 
+/*
+  QueryPerformanceCounter's frequency is fixed at boot, there's nothing to calibrate.
+ */
+static void calibrate_timer () {}
+
 static u64 get_timer_frequency () {
   LARGE_INTEGER frequency;
   QueryPerformanceFrequency(&frequency);
@@ -31,6 +36,13 @@ static u64 get_timer_value () {
   return stamp.QuadPart;
 }
 
+/*
+  QueryPerformanceCounter has no separate serializing variant.
+ */
+static u64 get_timer_value_serialized () {
+  return get_timer_value();
+}
+
 static u64 get_elapsed_millis (u64 frequency, u64 from, u64 to) {
   u64 elapsed = to - from;
 
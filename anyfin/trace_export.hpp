@@ -0,0 +1,189 @@
+#pragma once
+
+#include "anyfin/base.hpp"
+#include "anyfin/buffered_writer.hpp"
+#include "anyfin/platform.hpp"
+#include "anyfin/profiler.hpp"
+#include "anyfin/strings.hpp"
+#include "anyfin/timers.hpp"
+
+namespace Fin {
+
+/*
+  Exporter of the profiler's events into the Chrome Trace Event JSON format, which is understood by
+  chrome://tracing, Perfetto UI and Speedscope. Events are written out through the buffered writer as they are
+  drained from the threads' rings, thus the whole trace is never held in memory.
+
+    auto trace = begin_trace(writer);
+    ...
+    export_profile_events(trace); // Periodically, to keep the rings from overflowing
+    ...
+    end_trace(trace);
+ */
+struct Trace_Writer {
+  Buffered_Writer *writer;
+
+  u64 timer_frequency;
+  u32 process_id;
+
+  bool has_events = false;
+};
+
+/*
+  Timestamps are in microseconds, nanoseconds go into the fractional part.
+ */
+static Sys_Result<void> write_trace_time (Trace_Writer &trace, u64 nanos) {
+  char buffer[24];
+
+  char fraction[4] { '.', '0', '0', '0' };
+  for (u64 idx = 3, value = nanos % 1000; idx > 0; idx--, value /= 10) fraction[idx] = static_cast<char>('0' + value % 10);
+
+  String parts[] { render_unsigned(buffer, nanos / 1000), String(fraction, 4) };
+
+  return buffered_write(*trace.writer, Slice(parts));
+}
+
+/*
+  Strings are written out in runs of characters that don't need escaping, with escape sequences in between.
+ */
+static Sys_Result<void> write_trace_string (Trace_Writer &trace, String text) {
+  constexpr char hex_digits[] = "0123456789abcdef";
+
+  fin_check(buffered_write(*trace.writer, "\""));
+
+  usize run_start = 0;
+  for (usize idx = 0; idx < text.length; idx++) {
+    auto symbol = static_cast<u8>(text[idx]);
+    if (symbol >= 0x20 && symbol != '"' && symbol != '\\') continue;
+
+    fin_check(buffered_write(*trace.writer, String(text.value + run_start, idx - run_start)));
+    run_start = idx + 1;
+
+    char escape[6] { '\\', static_cast<char>(symbol), 0, 0, 0, 0 };
+    usize escape_length = 2;
+
+    if (symbol < 0x20) {
+      escape[1] = 'u';
+      escape[2] = '0';
+      escape[3] = '0';
+      escape[4] = hex_digits[symbol >> 4];
+      escape[5] = hex_digits[symbol & 0xf];
+      escape_length = 6;
+    }
+
+    fin_check(buffered_write(*trace.writer, String(escape, escape_length)));
+  }
+
+  fin_check(buffered_write(*trace.writer, String(text.value + run_start, text.length - run_start)));
+
+  return buffered_write(*trace.writer, "\"");
+}
+
+static Sys_Result<void> write_event_prefix (Trace_Writer &trace) {
+  auto separator = trace.has_events ? String(",\n") : String("\n");
+  trace.has_events = true;
+
+  return buffered_write(*trace.writer, separator);
+}
+
+static Sys_Result<Trace_Writer> begin_trace (Buffered_Writer &writer, u32 process_id = 1) {
+  fin_check(buffered_write(writer, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+
+  return Trace_Writer {
+    .writer          = &writer,
+    .timer_frequency = get_timer_frequency(),
+    .process_id      = process_id,
+  };
+}
+
+/*
+  Name shown for the thread's track in the viewer, instead of its id.
+ */
+static Sys_Result<void> write_thread_name (Trace_Writer &trace, u32 thread_id, String name) {
+  char pid_buffer[24], tid_buffer[24];
+
+  fin_check(write_event_prefix(trace));
+
+  String header[] {
+    "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":", render_unsigned(pid_buffer, trace.process_id),
+    ",\"tid\":", render_unsigned(tid_buffer, thread_id),
+    ",\"args\":{\"name\":",
+  };
+
+  fin_check(buffered_write(*trace.writer, Slice(header)));
+  fin_check(write_trace_string(trace, name));
+
+  return buffered_write(*trace.writer, "}}");
+}
+
+static Sys_Result<void> write_trace_event (Trace_Writer &trace, u32 thread_id, const Profile_Event &event) {
+  using enum Profile_Event_Kind;
+
+  char pid_buffer[24], tid_buffer[24], number_buffer[24];
+
+  auto &site = *event.site;
+
+  fin_check(write_event_prefix(trace));
+  fin_check(buffered_write(*trace.writer, "{\"name\":"));
+  fin_check(write_trace_string(trace, String(cast_bytes(site.name))));
+
+  String phase;
+  switch (site.kind) {
+    case Zone:    phase = ",\"ph\":\"X\",\"ts\":";          break;
+    case Instant: phase = ",\"ph\":\"i\",\"s\":\"t\",\"ts\":"; break;
+    case Counter: phase = ",\"ph\":\"C\",\"ts\":";          break;
+  }
+
+  fin_check(buffered_write(*trace.writer, phase));
+  fin_check(write_trace_time(trace, convert_ticks_to_nanos(trace.timer_frequency, event.timestamp)));
+
+  if (site.kind == Zone) {
+    fin_check(buffered_write(*trace.writer, ",\"dur\":"));
+    fin_check(write_trace_time(trace, get_elapsed_nanos(trace.timer_frequency, event.timestamp, event.value)));
+  }
+
+  String ids[] {
+    ",\"pid\":", render_unsigned(pid_buffer, trace.process_id),
+    ",\"tid\":", render_unsigned(tid_buffer, thread_id),
+  };
+  fin_check(buffered_write(*trace.writer, Slice(ids)));
+
+  if (site.kind == Counter) {
+    String args[] { ",\"args\":{\"value\":", render_unsigned(number_buffer, event.value), "}}" };
+    return buffered_write(*trace.writer, Slice(args));
+  }
+
+  fin_check(buffered_write(*trace.writer, ",\"args\":{\"file\":"));
+  fin_check(write_trace_string(trace, String(cast_bytes(site.callsite.file))));
+
+  String args[] { ",\"line\":", render_unsigned(number_buffer, site.callsite.line), "}}" };
+  return buffered_write(*trace.writer, Slice(args));
+}
+
+/*
+  Drain the profiler's rings into the trace. Returns the number of exported events, reading stops at the first
+  write error, the events that weren't written yet are lost in that case.
+ */
+static Sys_Result<usize> export_profile_events (Trace_Writer &trace) {
+  Sys_Result<void> status = Ok();
+
+  auto count = drain_profile_events([&] (const Profile_Buffer &buffer, const Profile_Event &event) {
+    if (status.is_error()) return;
+    status = write_trace_event(trace, buffer.thread_id, event);
+  });
+
+  if (status.is_error()) return move(status.error.value);
+
+  return count;
+}
+
+/*
+  Close the JSON document and flush the writer. The file itself remains open.
+ */
+static Sys_Result<void> end_trace (Trace_Writer &trace) {
+  fin_check(buffered_write(*trace.writer, "\n]}\n"));
+
+  return flush(*trace.writer);
+}
+
+}
@@ -0,0 +1,178 @@
+
+#include "anyfin/arena.hpp"
+#include "anyfin/bench.hpp"
+#include "anyfin/buffered_writer.hpp"
+#include "anyfin/file_system.hpp"
+#include "anyfin/hash.hpp"
+#include "anyfin/memory.hpp"
+#include "anyfin/sort.hpp"
+#include "anyfin/strings.hpp"
+
+using namespace Fin;
+
+static u8 scratch_memory[megabytes(4)];
+
+/*
+  Benchmarks reset their arenas on every iteration, thus they never share memory with the results in `main`.
+ */
+static u8 benchmark_memory[megabytes(1)];
+
+static char text_memory[kilobytes(16)];
+
+static String get_sample_text () {
+  for (usize idx = 0; idx < sizeof(text_memory); idx++) text_memory[idx] = static_cast<char>('a' + (idx * 7) % 26);
+  text_memory[sizeof(text_memory) - 1] = '\n';
+
+  return String(text_memory, sizeof(text_memory));
+}
+
+define_benchmark("memory/get_character_offset_16k") {
+  auto text = get_sample_text();
+
+  for (u64 idx = 0; idx < state.iterations; idx++) {
+    do_not_optimize(text.value);
+    do_not_optimize(get_character_offset(text.value, text.length, '\n'));
+  }
+}
+
+define_benchmark("memory/get_character_offset_reversed_16k") {
+  auto text = get_sample_text();
+
+  for (u64 idx = 0; idx < state.iterations; idx++) {
+    do_not_optimize(text.value);
+    do_not_optimize(get_character_offset_reversed(text.value, text.length, '/'));
+  }
+}
+
+define_benchmark("memory/get_any_character_offset_16k") {
+  auto text = get_sample_text();
+
+  for (u64 idx = 0; idx < state.iterations; idx++) {
+    do_not_optimize(text.value);
+    do_not_optimize(get_any_character_offset(text.value, text.length, "/\\\n", 3));
+  }
+}
+
+define_benchmark("strings/compare_strings_16k") {
+  auto text = get_sample_text();
+
+  for (u64 idx = 0; idx < state.iterations; idx++) {
+    do_not_optimize(text.value);
+    do_not_optimize(compare_strings(text, String(text.value, text.length)));
+  }
+}
+
+define_benchmark("strings/find_substring_16k") {
+  auto text = get_sample_text();
+
+  for (u64 idx = 0; idx < state.iterations; idx++) {
+    do_not_optimize(text.value);
+    do_not_optimize(find_substring(text, "undefined reference"));
+  }
+}
+
+define_benchmark("strings/split_string_16k") {
+  auto text = get_sample_text();
+
+  for (u64 idx = 0; idx < state.iterations; idx++) {
+    usize total = 0;
+    split_string(text, Char_Class("ae")).for_each([&total] (String token) { total += token.length; });
+    do_not_optimize(total);
+  }
+}
+
+define_benchmark("strings/copy_string_64") {
+  Memory_Arena arena { benchmark_memory };
+  auto text = String(get_sample_text().value, 64);
+
+  for (u64 idx = 0; idx < state.iterations; idx++) {
+    arena.offset = 0;
+    do_not_optimize(copy_string(arena, text));
+  }
+}
+
+define_benchmark("strings/write_integer") {
+  Memory_Arena arena { benchmark_memory };
+
+  u64 value = 12345;
+  for (u64 idx = 0; idx < state.iterations; idx++) {
+    arena.offset = 0;
+    value = value * 6364136223846793005ull + 1442695040888963407ull;
+    do_not_optimize(write_integer(arena, value >> (idx & 63)));
+  }
+}
+
+define_benchmark("arena/reserve_64") {
+  Memory_Arena arena { benchmark_memory };
+
+  for (u64 idx = 0; idx < state.iterations; idx++) {
+    if (arena.offset + 128 > arena.size) arena.offset = 0;
+    do_not_optimize(reserve<u8>(arena, 64, 16));
+  }
+}
+
+define_benchmark("sort/heap_sort_1k") {
+  Memory_Arena arena { benchmark_memory };
+
+  auto values = reserve_array<u32>(arena, 1024);
+
+  for (u64 idx = 0; idx < state.iterations; idx++) {
+    u32 seed = 12345;
+    for (auto &value: values) {
+      seed  = seed * 1664525u + 1013904223u;
+      value = seed;
+    }
+
+    sort(slice(values), [] (const u32 &left, const u32 &right) { return left < right; });
+    clobber_memory();
+  }
+}
+
+define_benchmark("hash/hash_64_16k") {
+  auto text = get_sample_text();
+
+  for (u64 idx = 0; idx < state.iterations; idx++) {
+    do_not_optimize(text.value);
+    do_not_optimize(hash_64(text));
+  }
+}
+
+/*
+  Usage: bench [--filter=<substring>] [--json=<path>]
+ */
+int main (int arguments_count, char **arguments) {
+  using enum File_System_Flags;
+
+  Memory_Arena arena { scratch_memory };
+
+  Bench_Options options {};
+  String json_path;
+
+  for (int idx = 1; idx < arguments_count; idx++) {
+    auto argument = String(cast_bytes(arguments[idx]));
+
+    if (starts_with(argument, "--filter=")) options.filter = String(argument.value + 9, argument.length - 9);
+    if (starts_with(argument, "--json="))   json_path      = String(argument.value + 7, argument.length - 7);
+  }
+
+  auto results = run_benchmarks(arena, options);
+
+  auto output = get_standard_output();
+  Buffered_Writer console { output, arena, kilobytes(4) };
+
+  if (write_bench_text(console, slice(results)).is_error() || flush(console).is_error()) return 1;
+
+  if (is_empty(json_path)) return 0;
+
+  auto [open_error, file] = open_file(json_path, Write_Access | Always_New);
+  if (open_error) return 1;
+
+  Buffered_Writer writer { file, arena };
+
+  auto status = write_bench_json(writer, slice(results));
+  if (!status.is_error()) status = flush(writer);
+
+  close_file(file);
+
+  return status.is_error() ? 1 : 0;
+}
@@ -86,6 +86,13 @@ extern "C" bool setup_project (const Arguments *args, Project *project) {
               platform, "kernel32.lib user32.lib advapi32.lib");
   }
 
+  auto bench = add_executable(project, "bench");
+  {
+    add_source_file(bench, "bench/main.cpp");
+    add_compiler_options(bench, "-O2", "-fno-exceptions");
+    add_linker_option(bench, "/subsystem:Console");
+    link_with(bench, "kernel32.lib");
+  }
 
   return true;
 }